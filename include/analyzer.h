@@ -0,0 +1,92 @@
+#pragma once
+
+#include "chip8.h"
+#include <bitset>
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Instruction handlers, named after the functions installed by
+ * init_dispatch_table(). op_null covers every opcode the dispatcher maps to a
+ * no-op.
+ */
+enum class op_t : uint8_t {
+  op_00E0,
+  op_00EE,
+  op_1nnn,
+  op_2nnn,
+  op_3xkk,
+  op_4xkk,
+  op_5xy0,
+  op_6xkk,
+  op_7xkk,
+  op_8xy0,
+  op_8xy1,
+  op_8xy2,
+  op_8xy3,
+  op_8xy4,
+  op_8xy5,
+  op_8xy6,
+  op_8xy7,
+  op_8xyE,
+  op_9xy0,
+  op_Annn,
+  op_Bnnn,
+  op_Cxkk,
+  op_Dxyn,
+  op_Ex9E,
+  op_ExA1,
+  op_F002,
+  op_Fx07,
+  op_Fx0A,
+  op_Fx15,
+  op_Fx18,
+  op_Fx1E,
+  op_Fx29,
+  op_Fx33,
+  op_Fx3A,
+  op_Fx55,
+  op_Fx65,
+  op_null
+};
+
+struct basic_block_t {
+  uint16_t start{};
+  uint16_t end{}; // one past the last instruction byte
+  std::vector<uint16_t> successors;
+  bool returns{};
+  bool indirect{};
+  bool self_modifying{};
+};
+
+struct memory_write_t {
+  uint16_t pc{};
+  uint16_t opcode{};
+  bool known{}; // false when I cannot be resolved statically
+  uint16_t first{};
+  uint16_t last{};
+  bool hits_code{};
+};
+
+struct analysis_t {
+  uint16_t entry{};
+  uint16_t rom_end{};
+  std::bitset<MEMORY_SIZE> code;         // bytes decoded as instructions
+  std::bitset<MEMORY_SIZE> instructions; // addresses where an instruction starts
+  std::map<uint16_t, basic_block_t> blocks;
+  std::set<uint16_t> subroutines;
+  std::vector<uint16_t> indirect_jumps;
+  std::vector<memory_write_t> writes;
+};
+
+op_t decode(uint16_t opcode);
+std::string disassemble(uint16_t opcode);
+
+analysis_t analyze(uint8_t const *memory, uint16_t rom_end,
+                   uint16_t entry = PROGRAM_START_ADDRESS);
+void write_text(std::ostream &out, analysis_t const &analysis,
+                uint8_t const *memory);
+void write_json(std::ostream &out, analysis_t const &analysis);
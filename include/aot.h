@@ -0,0 +1,105 @@
+#pragma once
+
+#include "chip8.h"
+#include <bitset>
+#include <cstddef>
+#include <string>
+
+struct analysis_t;
+
+/**
+ * @brief Services the interpreter provides to a recompiled module.
+ */
+struct aot_host_t {
+  void (*execute)(chip8_t *chip8, uint16_t opcode);
+};
+
+/**
+ * @brief One recompiled basic block. run() executes every instruction in
+ * [start, end), leaves pc and opcode as the interpreter would and returns the
+ * number of instructions executed.
+ */
+struct aot_block_t {
+  uint16_t start;
+  uint16_t end;
+  unsigned int (*run)(chip8_t *chip8);
+};
+
+uint64_t hash_memory(uint8_t const *memory);
+
+/**
+ * @brief Fingerprint of chip8_t and the module interface as compiled. A
+ * module records the value of its own build and load() refuses one built
+ * against other headers.
+ */
+constexpr uint64_t aot_layout() {
+  uint64_t const fields[] = {
+      sizeof(chip8_t),
+      offsetof(chip8_t, keypad),
+      offsetof(chip8_t, video),
+      offsetof(chip8_t, memory),
+      offsetof(chip8_t, registers),
+      offsetof(chip8_t, index),
+      offsetof(chip8_t, pc),
+      offsetof(chip8_t, delay_timer),
+      offsetof(chip8_t, sound_timer),
+      offsetof(chip8_t, stack),
+      offsetof(chip8_t, sp),
+      offsetof(chip8_t, opcode),
+      offsetof(chip8_t, audio_pattern),
+      offsetof(chip8_t, audio_pattern_loaded),
+      offsetof(chip8_t, audio_pitch),
+      offsetof(chip8_t, random_state),
+      sizeof(aot_block_t),
+      sizeof(aot_host_t),
+  };
+  uint64_t hash = 0xCBF29CE484222325u;
+  for (auto field : fields) {
+    hash ^= field;
+    hash *= 0x100000001B3u;
+  }
+  return hash;
+}
+
+/**
+ * @brief Translate the code recovered by analyze() into C++ source with one
+ * function per basic block.
+ */
+std::string translate(analysis_t const &analysis, uint8_t const *memory);
+
+/**
+ * @brief Compile translated source into a shared object with the system
+ * compiler ($CXX, or c++ when unset). The compiler is run directly, not
+ * through a shell, so paths may hold any character.
+ */
+void compile_module(path_t const &source, path_t const &output,
+                    path_t const &include_dir);
+
+/**
+ * @brief A recompiled ROM loaded with dlopen().
+ *
+ * run() executes the block starting at pc when there is one and falls back to
+ * run_cycle() otherwise. Blocks overwritten by Fx33/Fx55 are dropped, so
+ * self-modified code is always interpreted.
+ */
+class aot_module_t {
+public:
+  aot_module_t() = default;
+  ~aot_module_t();
+
+  aot_module_t(aot_module_t const &) = delete;
+  aot_module_t &operator=(aot_module_t const &) = delete;
+
+  void load(path_t const &filename, chip8_t const *chip8);
+  unsigned int run(chip8_t *chip8);
+
+private:
+  void invalidate(chip8_t const *chip8);
+
+  void *handle{};
+  aot_block_t const *blocks{};
+  size_t block_count{};
+
+  aot_block_t const *entries[MEMORY_SIZE]{};
+  std::bitset<MEMORY_SIZE> covered;
+};
@@ -0,0 +1,70 @@
+#include "chip8.h"
+#include "ring_buffer.h"
+#include <SDL2/SDL.h>
+#include <atomic>
+#include <cstdint>
+
+#ifndef CHIP8_INTERPRETER_AUDIO_H
+#define CHIP8_INTERPRETER_AUDIO_H
+
+struct audio_stats_t {
+  uint64_t underruns{};
+  uint64_t underrun_samples{};
+  size_t queued_samples{};
+  double latency_ms{};
+};
+
+/**
+ * @brief Buzzer and XO-CHIP pattern audio output.
+ *
+ * Samples are synthesized on the emulation thread by update() and handed to
+ * the SDL audio callback through a lock-free ring buffer. update() only tops
+ * the queue up to the configured level, so it never blocks and the amount of
+ * buffered audio (and therefore the latency) stays bounded.
+ *
+ * Callers that only reach update() at a fixed rate, such as one call per
+ * 60 Hz frame, say so with set_update_rate() so that build() grows the queue
+ * to cover the device for a whole period between calls.
+ */
+class audio_t {
+public:
+  audio_t() = default;
+  ~audio_t();
+
+  audio_t(audio_t const &) = delete;
+  audio_t &operator=(audio_t const &) = delete;
+
+  void build();
+  void update(chip8_t const *chip8);
+  audio_stats_t stats() const;
+
+  audio_t &set_sample_rate(int rate);
+  audio_t &set_device_samples(uint16_t samples);
+  audio_t &set_queue_samples(size_t samples);
+  audio_t &set_update_rate(int rate);
+  audio_t &set_tone_frequency(int frequency);
+  audio_t &set_volume(int16_t volume);
+
+private:
+  static void callback(void *userdata, uint8_t *stream, int length);
+  int16_t next_sample(chip8_t const *chip8);
+
+  SDL_AudioDeviceID device{};
+  std::unique_ptr<ring_buffer_t<int16_t>> queue;
+
+  int sample_rate = 44100;
+  uint16_t device_samples = 256;
+  size_t queue_samples = 512;
+  // Calls to update() per second; 0 when update() runs as often as it can.
+  int update_rate = 0;
+  int tone_frequency = 440;
+  int16_t volume = 3000;
+
+  // Oscillator state, owned by the emulation thread.
+  double phase{};
+
+  std::atomic<uint64_t> underruns{0};
+  std::atomic<uint64_t> underrun_samples{0};
+};
+
+#endif // CHIP8_INTERPRETER_AUDIO_H
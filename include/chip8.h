@@ -10,16 +10,28 @@ const unsigned int KEY_COUNT = 16;
 const unsigned int REGISTER_COUNT = 16;
 
 const unsigned int MEMORY_SIZE = 4096;
+const unsigned int MEMORY_MASK = MEMORY_SIZE - 1;
 const unsigned int STACK_SIZE = 16;
 
+// Guest memory is followed by a mirror of its first bytes and the stack is
+// padded to every value of the 8-bit sp, see memory.h.
+const unsigned int MEMORY_PADDING = 16;
+const unsigned int STACK_PADDING = 256 - STACK_SIZE;
+
 const int VIDEO_HEIGHT = 32;
 const int VIDEO_WIDTH = 64;
+const unsigned int PACKED_VIDEO_SIZE = VIDEO_WIDTH * VIDEO_HEIGHT / 8;
 
 const unsigned int FONTSET_SIZE = 80;
 const unsigned int FONTSET_START_ADDRESS = 0x50;
 
 const unsigned int PROGRAM_START_ADDRESS = 0x200;
 
+const unsigned int CYCLES_PER_FRAME = 10;
+
+const unsigned int AUDIO_PATTERN_SIZE = 16;
+const uint8_t DEFAULT_AUDIO_PITCH = 64;
+
 const unsigned int MAX_MEMORY = 0xFFF;
 const int MAX_ROM_SIZE = MAX_MEMORY - 0x200;
 
@@ -31,15 +43,19 @@ struct chip8_t {
 
   uint8_t keypad[KEY_COUNT]{};
   uint32_t video[VIDEO_WIDTH * VIDEO_HEIGHT]{};
-  uint8_t memory[MEMORY_SIZE]{};
+  uint8_t memory[MEMORY_SIZE + MEMORY_PADDING]{};
   uint8_t registers[REGISTER_COUNT]{};
   uint16_t index{};
   uint16_t pc{};
   uint8_t delay_timer{};
   uint8_t sound_timer{};
-  uint16_t stack[STACK_SIZE]{};
+  uint16_t stack[STACK_SIZE + STACK_PADDING]{};
   uint8_t sp{};
   uint16_t opcode{};
+  uint8_t audio_pattern[AUDIO_PATTERN_SIZE]{};
+  uint8_t audio_pattern_loaded{};
+  uint8_t audio_pitch{};
+  uint32_t random_state{};
 };
 
 using chip8_ptr_t = std::unique_ptr<chip8_t>;
@@ -47,4 +63,13 @@ using func_ptr = void (*)(chip8_t *chip8);
 
 chip8_ptr_t make_chip8();
 void load_rom(chip8_t *chip8, char const *filename);
-void run_cycle(chip8_t *chip8);
\ No newline at end of file
+void run_cycle(chip8_t *chip8);
+
+// The two halves of run_cycle(), for engines that keep their own clock.
+void step_instruction(chip8_t *chip8);
+void tick_timers(chip8_t *chip8);
+void seed_random(chip8_t *chip8, uint32_t seed);
+void execute_opcode(chip8_t *chip8, uint16_t opcode);
+func_ptr lookup_handler(uint16_t opcode);
+void pack_video(uint32_t const *video, uint8_t *packed);
+void unpack_video(uint8_t const *packed, uint32_t *video);
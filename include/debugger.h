@@ -0,0 +1,51 @@
+#pragma once
+
+#include "chip8.h"
+#include <bitset>
+#include <istream>
+#include <ostream>
+#include <string>
+
+/**
+ * @brief Interactive debugger with PC breakpoints and memory write
+ * watchpoints.
+ *
+ * The debugger wraps run_cycle() instead of hooking into it: breakpoints are
+ * tested against pc before each instruction, and watchpoints only when the
+ * next instruction is one of the memory-writing Fx33/Fx55, so the interpreter
+ * itself carries no debugging checks.
+ */
+class debugger_t {
+public:
+  debugger_t(std::istream &in, std::ostream &out);
+
+  debugger_t &add_breakpoint(uint16_t address);
+  debugger_t &remove_breakpoint(uint16_t address);
+  debugger_t &add_watchpoint(uint16_t first, uint16_t last);
+  debugger_t &remove_watchpoint(uint16_t first, uint16_t last);
+
+  /**
+   * @brief Execute one instruction, first stopping at the prompt if the
+   * debugger is paused or a breakpoint or watchpoint triggers.
+   *
+   * @return true when the user asked to quit.
+   */
+  bool run(chip8_t *chip8);
+
+private:
+  bool hit(chip8_t const *chip8);
+  bool prompt(chip8_t *chip8);
+  void print_location(chip8_t const *chip8);
+  void print_registers(chip8_t const *chip8);
+  void print_stack(chip8_t const *chip8);
+  void print_memory(chip8_t const *chip8, uint16_t address, uint16_t length);
+
+  std::istream &in;
+  std::ostream &out;
+
+  std::bitset<MEMORY_SIZE> breakpoints;
+  std::bitset<MEMORY_SIZE> watchpoints;
+
+  bool paused = true;
+  unsigned long steps{};
+};
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "chip8.h"
+#include "state.h"
+#include "thread_pool.h"
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Set of visited states, split into shards with one lock each so
+ * workers rarely contend. Every state remembers the state and action it was
+ * first reached from, which is enough to replay the inputs leading to it.
+ */
+class state_set_t {
+public:
+  struct origin_t {
+    uint64_t parent{};
+    uint16_t action{};
+  };
+
+  /**
+   * @brief Insert state unless it is present.
+   *
+   * @return true if it was new.
+   */
+  bool insert(uint64_t state, origin_t origin);
+
+  bool find(uint64_t state, origin_t &origin) const;
+  size_t size() const { return count.load(std::memory_order_relaxed); }
+
+private:
+  static const size_t SHARD_COUNT = 64;
+
+  struct shard_t {
+    mutable std::mutex mutex;
+    std::unordered_map<uint64_t, origin_t> states;
+  };
+
+  std::array<shard_t, SHARD_COUNT> shards;
+  std::atomic<size_t> count{};
+};
+
+struct explorer_finding_t {
+  uint64_t state{};
+  std::vector<uint16_t> inputs; // key mask held for each step from boot
+  uint16_t pc{};
+  std::string what;
+};
+
+struct explorer_report_t {
+  size_t states{};
+  unsigned int depth{};
+  bool exhausted{}; // every reachable state within the limits was visited
+  std::bitset<MEMORY_SIZE> pcs;
+  std::vector<explorer_finding_t> crashes;
+  std::vector<explorer_finding_t> soft_locks;
+};
+
+/**
+ * @brief Breadth-first search over keypad inputs.
+ *
+ * Each step holds one action, a key mask, for a number of frames, starting
+ * from every state of the current level. Children are deduplicated against
+ * every state seen so far, so each distinct state is expanded once. Levels
+ * are expanded in parallel.
+ *
+ * A child's hash reuses the memory and video parts of its parent's when the
+ * step did not write them. The core part is recomputed in full for every
+ * child, so the hash is not incremental in general.
+ *
+ * Frontier states are stored compactly, at under 1 KB each instead of a
+ * 13 KB chip8_t: memory is shared with the parent unless the step wrote to
+ * it, and video is kept at one bit per pixel.
+ *
+ * Instructions run through run_cycle_checked(); a memory_fault_t is reported
+ * as a crash. A state that no action changes is reported as a soft-lock.
+ * The search stops at max_depth steps or once max_states states are known,
+ * which also bounds memory.
+ */
+class explorer_t {
+public:
+  explorer_t(chip8_t const &boot,
+             unsigned int threads = std::thread::hardware_concurrency());
+
+  // By default the actions are no key and each single key.
+  explorer_t &set_actions(std::vector<uint16_t> actions);
+  explorer_t &set_frames_per_step(unsigned int frames);
+  explorer_t &set_max_depth(unsigned int depth);
+  explorer_t &set_max_states(size_t states);
+
+  explorer_report_t run();
+
+  std::vector<uint16_t> inputs_to(uint64_t state) const;
+
+private:
+  using memory_t = std::array<uint8_t, MEMORY_SIZE + MEMORY_PADDING>;
+
+  // Everything from registers to the end of chip8_t. The keypad is left out
+  // because each step overwrites it.
+  static constexpr size_t CORE_OFFSET = offsetof(chip8_t, registers);
+  static_assert(offsetof(chip8_t, memory) < CORE_OFFSET &&
+                offsetof(chip8_t, video) < CORE_OFFSET);
+
+  struct node_t {
+    std::shared_ptr<memory_t const> memory;
+    uint8_t video[PACKED_VIDEO_SIZE];
+    uint8_t core[sizeof(chip8_t) - CORE_OFFSET];
+    state_hash_t hash;
+  };
+
+  static node_t save(chip8_t const *chip8, state_hash_t const &hash,
+                     std::shared_ptr<memory_t const> memory);
+  static void restore(node_t const &node, chip8_t *chip8);
+
+  chip8_t boot;
+  thread_pool_t pool;
+
+  std::vector<uint16_t> actions;
+  unsigned int frames_per_step = 1;
+  unsigned int max_depth = 64;
+  size_t max_states = 20000;
+
+  state_set_t visited;
+};
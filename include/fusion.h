@@ -0,0 +1,63 @@
+#pragma once
+
+#include "chip8.h"
+
+// Longest group predecode() fuses, in instructions.
+const unsigned int MAX_FUSED_INSTRUCTIONS = 8;
+
+/**
+ * @brief Interpreter over a predecoded copy of guest memory that runs common
+ * instruction idioms as one fused handler.
+ *
+ * Every address holds its opcode and the handler lookup_handler() resolves
+ * for it, so the fetch and the dispatch tables are skipped. Where a run of
+ * instructions matches one of these idioms, the entry also holds a handler
+ * for the whole group:
+ *
+ *   Annn, Dxyn             sprite draw
+ *   6xkk, 6ykk, ...        register initialisation, up to 8 instructions
+ *   7xkk, 3ykk, 1nnn       counted loop
+ *   Fx07, 3xkk, 1nnn       delay timer wait
+ *
+ * Fused handlers leave exactly the state run_cycle() would after the same
+ * number of instructions, including pc, opcode and both timers. The loops
+ * keep iterating while they jump back to their own start and the budget
+ * allows. Entries are refreshed after every Fx33 and Fx55, so self-modifying
+ * code sees its stores; call predecode() again after writing guest memory
+ * from outside.
+ */
+class fused_program_t {
+public:
+  void predecode(chip8_t const *chip8);
+
+  /**
+   * @brief Run the entry at pc: its fused group if the whole group fits in
+   * budget instructions, otherwise a single instruction.
+   *
+   * @return The number of instructions executed, at most budget.
+   */
+  unsigned int step(chip8_t *chip8, unsigned int budget);
+
+  /**
+   * @brief Execute exactly count instructions, like count run_cycle() calls.
+   */
+  void run(chip8_t *chip8, unsigned int count);
+
+  struct entry_t;
+  using handler_t = unsigned int (*)(chip8_t *chip8, entry_t const *entry,
+                                     unsigned int budget);
+
+  struct entry_t {
+    handler_t fused;   // null unless a group starts here
+    func_ptr handler;  // this instruction alone
+    uint16_t opcode;
+    uint8_t length{1}; // instructions in the fused group
+    bool stores{};     // Fx33 or Fx55
+  };
+
+private:
+  void predecode(chip8_t const *chip8, unsigned int address);
+
+  // One entry per byte address: jumps may land on odd addresses.
+  entry_t entries[MEMORY_SIZE]{};
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+struct latency_report_t {
+  size_t samples{};
+  double p50_ms{};
+  double p99_ms{};
+  double max_ms{};
+  // Time events spent in the SDL queue before process_input() saw them.
+  double queued_p50_ms{};
+  double queued_p99_ms{};
+};
+
+/**
+ * @brief Input-to-present latency of key presses.
+ *
+ * The viewer reports every key event that changes the keypad, with the time
+ * it was written and how long it waited in the event queue, and every
+ * present. Each pending event is closed by the first present after it, so a
+ * sample spans the event queue, emulation up to the next frame and
+ * rendering. Timestamps are performance-counter ticks at the given
+ * frequency. The present is the last point the application sees; display
+ * scan-out adds a constant on top.
+ */
+class latency_tracer_t {
+public:
+  explicit latency_tracer_t(uint64_t frequency);
+
+  void key_written(uint64_t counter, uint32_t queued_ms);
+  void presented(uint64_t counter);
+
+  latency_report_t report() const;
+  void write_report(std::ostream &out) const;
+
+private:
+  uint64_t frequency;
+  std::vector<std::pair<uint64_t, uint32_t>> pending;
+  std::vector<double> total_ms;
+  std::vector<double> queued_ms;
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "chip8.h"
+#include <vector>
+
+/**
+ * @brief Fixed number of machines in one arena, all reset from a template
+ * image.
+ *
+ * The image is a booted machine, font and ROM already loaded, so handing out
+ * or resetting a machine is a single memcpy with no allocation and no
+ * initialization. The arena is one mapping backed by explicit huge pages
+ * where the system has them reserved, and otherwise by ordinary pages with
+ * transparent huge pages requested. Machines are spaced a cache line apart
+ * so threads stepping neighbours do not share lines. Pages are only touched
+ * when a machine is first handed out.
+ *
+ * Not thread-safe; give each thread its own pool or hand machines out
+ * before the threads start.
+ */
+class machine_pool_t {
+public:
+  machine_pool_t(chip8_t const &image, size_t capacity);
+  ~machine_pool_t();
+
+  machine_pool_t(machine_pool_t const &) = delete;
+  machine_pool_t &operator=(machine_pool_t const &) = delete;
+
+  /**
+   * @brief A machine in the state of the image.
+   *
+   * @return nullptr if every machine is in use.
+   */
+  chip8_t *acquire();
+
+  /**
+   * @brief Return a machine to the pool.
+   *
+   * @throw std::invalid_argument if chip8 was not handed out by this pool
+   * or has already been released.
+   */
+  void release(chip8_t *chip8);
+
+  /**
+   * @brief Copy the image into chip8, then reseed its Cxkk generator from the
+   * base seed, the machine's slot and how often the slot was reset, so no
+   * two machines or episodes draw the same stream. Machines in different
+   * slots may be reset from different threads.
+   */
+  void reset(chip8_t *chip8);
+
+  /**
+   * @brief Base of every machine's seed, by default the image's own. Takes
+   * effect from the next acquire() or reset().
+   */
+  machine_pool_t &set_seed(uint32_t seed);
+  uint32_t seed() const { return base_seed; }
+
+  chip8_t const &boot_image() const { return image; }
+  size_t capacity() const { return count; }
+  size_t available() const { return free_list.size() + count - constructed; }
+  bool huge_pages() const { return hugetlb; }
+
+private:
+  static const size_t STRIDE = (sizeof(chip8_t) + 63) / 64 * 64;
+
+  size_t slot(chip8_t const *chip8) const {
+    return static_cast<size_t>(reinterpret_cast<uint8_t const *>(chip8) -
+                               arena) /
+           STRIDE;
+  }
+  void reseed(chip8_t *chip8);
+
+  chip8_t image;
+  size_t count;
+  uint32_t base_seed;
+  std::vector<uint64_t> episodes; // resets of each slot so far
+
+  uint8_t *arena{};
+  size_t arena_size{};
+  bool hugetlb{};
+
+  size_t constructed{}; // machines [0, constructed) have been handed out
+  std::vector<chip8_t *> free_list;
+  std::vector<bool> released; // by slot, whether the slot is on free_list
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "chip8.h"
+#include <stdexcept>
+#include <string>
+
+/*
+ * Guest memory model.
+ *
+ * The fast path never masks individual accesses. Instead it keeps pc and I
+ * inside the 4 KB address space (pc is wrapped once per fetch, I whenever
+ * Fx1E moves it) and relies on chip8_t::memory being followed by
+ * MEMORY_PADDING bytes that mirror its first bytes. Every access is at most
+ * 15 bytes past I or one byte past pc, so reads that run off the end land in
+ * the mirror and see the wrapped-around data. Stores that reach the mirror
+ * are folded back by commit_write(), which also refreshes the mirror when the
+ * low bytes change. The stack is padded to cover every value of the 8-bit sp.
+ *
+ * The checked mode runs the same handlers but first validates the next
+ * instruction and throws memory_fault_t where the fast path would wrap.
+ * */
+
+/**
+ * @brief Copy the first MEMORY_PADDING bytes of guest memory into the mirror.
+ * Call after writing guest memory directly.
+ */
+inline void sync_memory_mirror(chip8_t *chip8) {
+  std::memcpy(chip8->memory + MEMORY_SIZE, chip8->memory, MEMORY_PADDING);
+}
+
+/**
+ * @brief Finish a store of length bytes at first, with first < MEMORY_SIZE.
+ */
+inline void commit_write(chip8_t *chip8, unsigned int first,
+                         unsigned int length) {
+  auto end = first + length;
+  if (end > MEMORY_SIZE)
+    std::memcpy(chip8->memory, chip8->memory + MEMORY_SIZE, end - MEMORY_SIZE);
+  if (first < MEMORY_PADDING || end > MEMORY_SIZE)
+    sync_memory_mirror(chip8);
+}
+
+/**
+ * @brief An access the checked mode refused to perform.
+ */
+class memory_fault_t : public std::runtime_error {
+public:
+  memory_fault_t(std::string const &what, chip8_t const *chip8,
+                 uint16_t opcode);
+
+  uint16_t pc;
+  uint16_t opcode;
+  uint16_t index;
+  uint8_t sp;
+};
+
+/**
+ * @brief run_cycle() that traps stack overflow and underflow, out-of-range
+ * pc, I and memory accesses, and invalid keys instead of wrapping them.
+ */
+void run_cycle_checked(chip8_t *chip8);
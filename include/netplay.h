@@ -0,0 +1,165 @@
+#pragma once
+
+#include "chip8.h"
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <netinet/in.h>
+#include <string>
+#include <vector>
+
+// Both peers seed Cxkk with this so their machines stay identical.
+const uint32_t NETPLAY_SEED = 0xC8C8C8C8u;
+
+// Frames a peer may run ahead of the last input it has from the other. It
+// bounds the frames resimulated by one rollback.
+const unsigned int NETPLAY_MAX_ROLLBACK = 8;
+
+/*
+ * Packet layout, little-endian:
+ *
+ *   magic u32, first u32, count u8, count key masks u16, ack u32,
+ *   hash_frame u32, hash u64
+ *
+ * The masks are the sender's inputs for frames first to first + count - 1:
+ * every input the other peer has not acknowledged yet, so a lost packet is
+ * covered by the next one. ack is the number of the receiver's inputs the
+ * sender holds. hash_frame is the number of frames the sender confirmed and
+ * hash the state hash after the last of them, zero before the first one.
+ * */
+
+const uint32_t NETPLAY_MAGIC = 0x504E3843; // "C8NP"
+
+/**
+ * @brief Non-blocking UDP socket to one peer that can simulate a bad link.
+ *
+ * Outgoing packets are held back by the configured one-way latency and
+ * dropped with the configured probability, drawn from a seeded xorshift
+ * generator so a run can be reproduced. Delayed packets leave on the next
+ * send() or receive().
+ */
+class udp_link_t {
+public:
+  udp_link_t(uint16_t local_port, std::string const &remote_host,
+             uint16_t remote_port);
+  ~udp_link_t();
+
+  udp_link_t(udp_link_t const &) = delete;
+  udp_link_t &operator=(udp_link_t const &) = delete;
+
+  udp_link_t &set_latency(std::chrono::microseconds latency);
+  udp_link_t &set_loss(double probability);
+  udp_link_t &set_seed(uint32_t seed);
+
+  void send(std::vector<uint8_t> packet);
+
+  /**
+   * @brief Receive one packet from the peer.
+   *
+   * @return false if none is waiting.
+   */
+  bool receive(std::vector<uint8_t> &packet);
+
+private:
+  using clock_t = std::chrono::steady_clock;
+
+  void flush();
+
+  int socket_fd = -1;
+  sockaddr_in remote{};
+
+  std::chrono::microseconds latency{};
+  uint32_t loss_threshold{};
+  uint32_t random_state = 0x2545F491u;
+  std::deque<std::pair<clock_t::time_point, std::vector<uint8_t>>> delayed;
+};
+
+struct netplay_stats_t {
+  uint64_t frames{};
+  uint64_t stalls{}; // advance() calls that waited for the peer
+  uint64_t rollbacks{};
+  uint64_t resimulated_frames{};
+  unsigned int max_rollback{};
+  double max_rollback_ms{};
+  uint64_t packets_sent{};
+  uint64_t packets_received{};
+  uint64_t desyncs{}; // confirmed frames whose hashes differ between peers
+};
+
+/**
+ * @brief Rollback lockstep for two peers running the same ROM.
+ *
+ * Each frame runs with the keys both players hold, or-ed together. The
+ * local keys are sent to the peer right away, and while the peer's keys for
+ * a frame are still on the way the frame runs with their last known keys.
+ * When the real keys turn out different, the machine is restored from the
+ * snapshot taken before the first mispredicted frame and every frame since
+ * is run again, which is at most NETPLAY_MAX_ROLLBACK frames of
+ * CYCLES_PER_FRAME instructions, well within one frame's time. A peer that
+ * gets NETPLAY_MAX_ROLLBACK frames ahead stalls until inputs arrive.
+ *
+ * Frames with both players' keys known are confirmed. Their state hashes
+ * are exchanged, so the peers detect a desync.
+ */
+class netplay_t {
+public:
+  using confirmed_fn_t =
+      std::function<void(uint64_t frame, chip8_t const *chip8)>;
+
+  explicit netplay_t(udp_link_t &link);
+
+  /**
+   * @brief Called with the state after every confirmed frame, in order.
+   */
+  netplay_t &set_on_confirmed(confirmed_fn_t on_confirmed);
+
+  /**
+   * @brief Run one frame of chip8 with local_keys, a mask with bit k for
+   * key k, rolling back first if a prediction turned out wrong.
+   *
+   * chip8 must start from the same state on both peers, seeded with
+   * NETPLAY_SEED. On return chip8->keypad holds the local keys alone, so a
+   * frontend can keep editing it.
+   *
+   * @return false if the frame did not run because the peer is too far
+   * behind.
+   */
+  bool advance(chip8_t *chip8, uint16_t local_keys);
+
+  uint64_t frame() const { return current; }
+  uint64_t confirmed_frames() const { return confirmed; }
+  netplay_stats_t const &stats() const { return statistics; }
+
+private:
+  static const unsigned int HISTORY = 4 * NETPLAY_MAX_ROLLBACK;
+
+  void poll(chip8_t *chip8);
+  void receive_packet(std::vector<uint8_t> const &packet);
+  void rollback(chip8_t *chip8, uint64_t from);
+  void run_frame(chip8_t *chip8, uint64_t frame);
+  void confirm(chip8_t const *chip8);
+  void send_inputs();
+  uint16_t remote_keys(uint64_t frame) const;
+
+  udp_link_t &link;
+  confirmed_fn_t on_confirmed;
+
+  uint64_t current{}; // next frame to run
+  uint64_t remote_known{}; // the peer's keys are known below this frame
+  uint64_t remote_acked{}; // the peer holds our keys below this frame
+  uint64_t confirmed{}; // frames with both keys known and run
+
+  // Indexed by frame % HISTORY.
+  uint16_t local_inputs[HISTORY]{};
+  uint16_t remote_inputs[HISTORY]{};
+  uint16_t predicted[HISTORY]{}; // remote keys the frame last ran with
+  std::vector<chip8_t> snapshots; // state before each frame
+  uint64_t hashes[HISTORY]{}; // state after each confirmed frame
+
+  uint64_t remote_hash_frame{};
+  uint64_t remote_hash{};
+  uint64_t compared_hash_frame{};
+
+  netplay_stats_t statistics;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "chip8.h"
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct analysis_t;
+
+/**
+ * @brief Sampling profiler for guest code.
+ *
+ * Every interval instructions it records the guest call stack: the entry
+ * point, the subroutine entered by each 2nnn still on chip8_t::stack, and the
+ * current pc. write_collapsed() emits the samples in the folded format read
+ * by flamegraph.pl and speedscope.
+ */
+class profiler_t {
+public:
+  // The default interval is prime so sampling does not run in lockstep with
+  // guest loops.
+  explicit profiler_t(unsigned int interval = 97);
+
+  profiler_t &add_symbols(analysis_t const &analysis);
+  profiler_t &load_symbols(path_t const &filename);
+
+  void run(chip8_t *chip8);
+  void sample(chip8_t const *chip8);
+
+  void write_collapsed(std::ostream &out) const;
+
+private:
+  std::string symbol(uint16_t address) const;
+
+  unsigned int interval;
+  unsigned int countdown;
+  uint16_t entry = PROGRAM_START_ADDRESS;
+
+  std::map<uint16_t, std::string> symbols;
+  std::map<std::vector<uint16_t>, uint64_t> samples;
+};
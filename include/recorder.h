@@ -0,0 +1,117 @@
+#pragma once
+
+#include "chip8.h"
+#include "ring_buffer.h"
+#include <atomic>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+const uint32_t RECORDING_MAGIC = 0x43385243; // "C8RC"
+const uint32_t RECORDING_VERSION = 1;
+const unsigned int DEFAULT_KEYFRAME_INTERVAL = 300;
+
+/*
+ * Recording file layout, all integers little-endian:
+ *
+ *   header   magic u32, version u32, keyframe interval u32,
+ *            width u16, height u16
+ *   records  type u8, length u32, payload
+ *   index    frame count u64, keyframe count u32,
+ *            keyframe count * (frame u64, record offset u64)
+ *   trailer  index offset u64, magic u32
+ *
+ * A keyframe payload is the packed 1-bpp frame, a delta payload the frame
+ * XORed with the previous one. Both are run-length encoded as alternating
+ * varint counts of zero bytes and of literal bytes followed by the literals,
+ * so an unchanged frame takes three bytes. Records flagged RECORD_ZSTD are
+ * additionally zstd-compressed. A recording cut short by a crash has no
+ * index; the reader then rebuilds it by scanning the records.
+ * */
+
+const uint8_t RECORD_KEYFRAME = 0;
+const uint8_t RECORD_DELTA = 1;
+const uint8_t RECORD_ZSTD = 0x80;
+
+struct packed_frame_t {
+  uint8_t pixels[PACKED_VIDEO_SIZE]{};
+};
+
+/**
+ * @brief Writes every captured frame to a recording.
+ *
+ * capture() packs the framebuffer and pushes it into a lock-free queue; the
+ * encoding and the file writes happen on a background thread. A frame that
+ * does not fit in the queue is dropped and counted rather than stalling the
+ * emulator. The destructor drains the queue and writes the keyframe index.
+ */
+class recorder_t {
+public:
+  explicit recorder_t(
+      path_t const &filename,
+      unsigned int keyframe_interval = DEFAULT_KEYFRAME_INTERVAL,
+      size_t queue_frames = 256);
+  ~recorder_t();
+
+  recorder_t(recorder_t const &) = delete;
+  recorder_t &operator=(recorder_t const &) = delete;
+
+  void capture(chip8_t const *chip8);
+
+  uint64_t dropped_frames() const { return dropped; }
+
+private:
+  void encode();
+  void write_record(uint8_t type, std::vector<uint8_t> const &payload);
+
+  std::ofstream file;
+  unsigned int keyframe_interval;
+
+  ring_buffer_t<packed_frame_t> queue;
+  std::atomic<bool> closing{};
+  std::atomic<uint64_t> dropped{};
+  std::thread encoder;
+
+  // Owned by the encoder thread.
+  packed_frame_t previous;
+  uint64_t frames{};
+  std::vector<std::pair<uint64_t, uint64_t>> keyframes;
+};
+
+/**
+ * @brief Decodes a recording, sequentially or by seeking to any frame.
+ */
+class recording_reader_t {
+public:
+  explicit recording_reader_t(path_t const &filename);
+
+  uint64_t frame_count() const { return frames; }
+  unsigned int keyframe_interval() const { return interval; }
+
+  /**
+   * @brief Decode the next frame into packed.
+   *
+   * @return false at the end of the recording.
+   */
+  bool next(uint8_t *packed);
+
+  /**
+   * @brief Decode the given frame, replaying from the closest keyframe at or
+   * before it unless the reader is already between the two.
+   */
+  void seek(uint64_t frame, uint8_t *packed);
+
+private:
+  void scan_records();
+
+  std::vector<uint8_t> data;
+  size_t records_end{};
+  unsigned int interval{};
+
+  uint64_t frames{};
+  std::vector<std::pair<uint64_t, uint64_t>> keyframes;
+
+  size_t offset{};
+  uint64_t position{};
+  packed_frame_t current;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+
+/**
+ * @brief Lock-free single-producer/single-consumer ring buffer.
+ *
+ * One thread may push and one other thread may pop concurrently. Neither side
+ * ever blocks: push() stores as many elements as fit and pop() returns as many
+ * as are available. The capacity is rounded up to a power of two so that
+ * positions can be wrapped with a mask.
+ */
+template <typename T> class ring_buffer_t {
+public:
+  explicit ring_buffer_t(std::size_t capacity) {
+    if (capacity == 0)
+      throw std::invalid_argument("Ring buffer capacity must not be zero.");
+
+    std::size_t size = 1;
+    while (size < capacity)
+      size <<= 1u;
+
+    elements = std::make_unique<T[]>(size);
+    mask = size - 1;
+  }
+
+  ring_buffer_t(ring_buffer_t const &) = delete;
+  ring_buffer_t &operator=(ring_buffer_t const &) = delete;
+
+  std::size_t push(T const *data, std::size_t count) {
+    auto tail = write_pos.load(std::memory_order_relaxed);
+    auto head = read_pos.load(std::memory_order_acquire);
+
+    count = std::min(count, capacity() - (tail - head));
+    for (std::size_t i = 0; i < count; ++i)
+      elements[(tail + i) & mask] = data[i];
+
+    write_pos.store(tail + count, std::memory_order_release);
+    return count;
+  }
+
+  bool push(T const &value) { return push(&value, 1) == 1; }
+
+  std::size_t pop(T *data, std::size_t count) {
+    auto head = read_pos.load(std::memory_order_relaxed);
+    auto tail = write_pos.load(std::memory_order_acquire);
+
+    count = std::min(count, tail - head);
+    for (std::size_t i = 0; i < count; ++i)
+      data[i] = elements[(head + i) & mask];
+
+    read_pos.store(head + count, std::memory_order_release);
+    return count;
+  }
+
+  bool pop(T &value) { return pop(&value, 1) == 1; }
+
+  /**
+   * @brief Number of queued elements. Exact only when called from the
+   * producer or the consumer thread, an estimate otherwise.
+   */
+  std::size_t size() const {
+    return write_pos.load(std::memory_order_acquire) -
+           read_pos.load(std::memory_order_acquire);
+  }
+
+  std::size_t capacity() const { return mask + 1; }
+
+private:
+  std::unique_ptr<T[]> elements;
+  std::size_t mask{};
+
+  // Keep the two positions on separate cache lines so that the producer and
+  // the consumer do not invalidate each other's line on every update.
+  alignas(64) std::atomic<std::size_t> write_pos{0};
+  alignas(64) std::atomic<std::size_t> read_pos{0};
+};
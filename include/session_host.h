@@ -0,0 +1,154 @@
+#pragma once
+
+#include "chip8.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using session_clock_t = std::chrono::steady_clock;
+
+/**
+ * @brief Coroutine that plays one session. It starts suspended and is only
+ * ever resumed by the host's workers.
+ */
+class session_task_t {
+public:
+  struct promise_type {
+    session_task_t get_return_object() {
+      return session_task_t(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { error = std::current_exception(); }
+
+    session_clock_t::time_point deadline;
+    std::exception_ptr error;
+  };
+
+  using handle_t = std::coroutine_handle<promise_type>;
+
+  session_task_t() = default;
+  explicit session_task_t(handle_t handle) : handle(handle) {}
+  session_task_t(session_task_t &&other) noexcept
+      : handle(std::exchange(other.handle, {})) {}
+  session_task_t &operator=(session_task_t &&other) noexcept;
+  ~session_task_t();
+
+  handle_t handle;
+};
+
+/**
+ * @brief Suspends a session until its next frame deadline.
+ *
+ * It only records the deadline; the worker that resumed the session queues
+ * it again once the coroutine is suspended, so no other thread can pick it
+ * up while it is still running.
+ */
+struct next_frame_t {
+  session_clock_t::time_point deadline;
+
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(session_task_t::handle_t handle) const noexcept {
+    handle.promise().deadline = deadline;
+  }
+  void await_resume() const noexcept {}
+};
+
+struct session_stats_t {
+  uint64_t frames{};
+  uint64_t late_frames{};
+  session_clock_t::duration max_lateness{};
+  bool finished{};
+  std::string error;
+};
+
+/**
+ * @brief Runs many real-time machines in one process.
+ *
+ * Each session is a coroutine that executes one frame's worth of run_cycle()
+ * calls and then suspends until its next deadline, one frame period after
+ * the previous one. Suspended sessions wait in a deadline-ordered queue that
+ * a small pool of workers drains, sleeping until the earliest deadline. A
+ * session that falls more than a period behind skips ahead instead of
+ * bursting frames to catch up. Frames that start more than a period after
+ * their deadline are counted as late.
+ */
+class session_host_t {
+public:
+  // Called after every frame on the worker running the session; returning
+  // true ends the session.
+  using frame_fn_t = std::function<bool(size_t session, chip8_t *chip8)>;
+
+  explicit session_host_t(unsigned int threads = 2);
+  ~session_host_t();
+
+  session_host_t(session_host_t const &) = delete;
+  session_host_t &operator=(session_host_t const &) = delete;
+
+  session_host_t &set_frame_period(session_clock_t::duration period);
+  session_host_t &set_cycles_per_frame(unsigned int cycles);
+  session_host_t &set_on_frame(frame_fn_t on_frame);
+
+  size_t add(chip8_ptr_t chip8);
+
+  /**
+   * @brief Play every session until each has ended or stop() is called.
+   * The calling thread is one of the workers.
+   */
+  void run();
+
+  /**
+   * @brief Make run() return once the frames in progress are done. Sessions
+   * stay suspended and a stopped host cannot be run again.
+   */
+  void stop();
+
+  size_t size() const;
+  session_stats_t stats(size_t session) const;
+
+private:
+  struct session_t {
+    size_t id{};
+    chip8_ptr_t chip8;
+    session_task_t task;
+    session_stats_t stats;
+  };
+
+  struct ready_t {
+    session_clock_t::time_point deadline;
+    session_t *session;
+
+    bool operator>(ready_t const &other) const {
+      return deadline > other.deadline;
+    }
+  };
+
+  session_task_t play(session_t &session);
+  void work();
+
+  unsigned int threads;
+  session_clock_t::duration frame_period =
+      std::chrono::microseconds(1000000 / 60);
+  unsigned int cycles_per_frame = CYCLES_PER_FRAME;
+  frame_fn_t on_frame;
+
+  std::vector<std::unique_ptr<session_t>> sessions;
+
+  mutable std::mutex mutex;
+  std::condition_variable wake;
+  std::priority_queue<ready_t, std::vector<ready_t>, std::greater<>> ready;
+  size_t live{};
+  std::atomic<bool> stopping{};
+};
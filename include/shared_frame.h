@@ -0,0 +1,89 @@
+#pragma once
+
+#include "chip8.h"
+#include <atomic>
+#include <string>
+
+const uint32_t SHARED_FRAME_MAGIC = 0x43385346; // "C8SF"
+const uint32_t SHARED_FRAME_VERSION = 1;
+
+/**
+ * @brief Machine state published to other processes once per frame.
+ */
+struct machine_frame_t {
+  uint64_t frame{};
+  uint32_t video[VIDEO_WIDTH * VIDEO_HEIGHT]{};
+  uint8_t registers[REGISTER_COUNT]{};
+  uint16_t index{};
+  uint16_t pc{};
+  uint8_t delay_timer{};
+  uint8_t sound_timer{};
+  uint16_t stack[STACK_SIZE]{};
+  uint8_t sp{};
+  uint8_t keypad[KEY_COUNT]{};
+};
+
+/**
+ * @brief Layout of the shared-memory segment.
+ *
+ * The frame is guarded by a sequence lock: the writer makes sequence odd
+ * while it copies and even again when it is done, and readers retry until
+ * they see the same even value before and after their copy. Keys flow the
+ * other way through a bitmask that consumers update atomically.
+ */
+struct shared_segment_t {
+  uint32_t magic;
+  uint32_t version;
+  alignas(64) std::atomic<uint32_t> sequence;
+  machine_frame_t frame;
+  alignas(64) std::atomic<uint32_t> injected_keys;
+};
+
+/**
+ * @brief Owns a segment and publishes one machine into it.
+ *
+ * The segment is created exclusively; constructing a writer on a name that
+ * already exists throws instead of sharing it with another writer.
+ */
+class shared_frame_writer_t {
+public:
+  explicit shared_frame_writer_t(std::string name);
+  ~shared_frame_writer_t();
+
+  shared_frame_writer_t(shared_frame_writer_t const &) = delete;
+  shared_frame_writer_t &operator=(shared_frame_writer_t const &) = delete;
+
+  void publish(chip8_t const *chip8);
+  void apply_input(chip8_t *chip8);
+
+private:
+  std::string name;
+  shared_segment_t *segment{};
+  uint64_t frame{};
+  uint32_t applied_keys{};
+};
+
+/**
+ * @brief Attaches to a segment created by shared_frame_writer_t.
+ */
+class shared_frame_reader_t {
+public:
+  explicit shared_frame_reader_t(std::string const &name);
+  ~shared_frame_reader_t();
+
+  shared_frame_reader_t(shared_frame_reader_t const &) = delete;
+  shared_frame_reader_t &operator=(shared_frame_reader_t const &) = delete;
+
+  /**
+   * @brief Copy the latest consistent frame.
+   *
+   * @return false if no frame newer than last_frame has been published.
+   */
+  bool read(machine_frame_t &frame, uint64_t last_frame = 0) const;
+
+  void press(uint8_t key);
+  void release(uint8_t key);
+
+private:
+  shared_segment_t *segment{};
+};
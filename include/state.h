@@ -0,0 +1,55 @@
+#pragma once
+
+#include "chip8.h"
+#include <type_traits>
+
+// Cloning and restoring a machine is a plain copy.
+static_assert(std::is_trivially_copyable_v<chip8_t>);
+
+/**
+ * @brief 64-bit hash of a machine state, kept as three parts so that a
+ * child state can reuse the parts its parent left untouched.
+ *
+ * core covers everything that decides future execution besides memory and
+ * video: registers, I, pc, timers, the live part of the stack, the random
+ * state and the audio pattern. The keypad and the last opcode are not part
+ * of the state; they are overwritten before they are read again.
+ */
+struct state_hash_t {
+  uint64_t core{};
+  uint64_t memory{};
+  uint64_t video{};
+
+  uint64_t value() const;
+  bool operator==(state_hash_t const &) const = default;
+};
+
+/**
+ * @brief Parts of a machine written since its hash was taken.
+ */
+struct state_dirty_t {
+  bool memory{};
+  bool video{};
+};
+
+uint64_t hash_bytes(void const *data, size_t size, uint64_t seed = 0);
+
+state_hash_t hash_state(chip8_t const *chip8);
+
+/**
+ * @brief Hash chip8 given the hash of an earlier state of it, recomputing
+ * memory and video only when dirty says they were written.
+ */
+state_hash_t rehash_state(chip8_t const *chip8, state_hash_t const &previous,
+                          state_dirty_t dirty);
+
+/**
+ * @brief Mark the parts written by the instruction just run, chip8->opcode.
+ */
+inline void note_writes(chip8_t const *chip8, state_dirty_t &dirty) {
+  auto opcode = chip8->opcode;
+  if (opcode == 0x00E0u || (opcode & 0xF000u) == 0xD000u)
+    dirty.video = true;
+  else if ((opcode & 0xF0FFu) == 0xF033u || (opcode & 0xF0FFu) == 0xF055u)
+    dirty.memory = true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Fixed set of worker threads that run data-parallel loops.
+ *
+ * parallel_for() hands out indices in chunks from a shared counter and
+ * returns once every index has been processed. The calling thread takes part
+ * in the work, so a pool of one thread runs everything inline.
+ */
+class thread_pool_t {
+public:
+  explicit thread_pool_t(
+      unsigned int threads = std::thread::hardware_concurrency());
+  ~thread_pool_t();
+
+  thread_pool_t(thread_pool_t const &) = delete;
+  thread_pool_t &operator=(thread_pool_t const &) = delete;
+
+  void parallel_for(size_t count, std::function<void(size_t)> const &body,
+                    size_t chunk = 1);
+
+  unsigned int size() const {
+    return static_cast<unsigned int>(workers.size()) + 1;
+  }
+
+private:
+  void work();
+  void run_chunks();
+
+  std::vector<std::thread> workers;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable finished;
+  bool stopping{};
+  uint64_t generation{};
+  unsigned int active{};
+
+  std::function<void(size_t)> const *job{};
+  size_t job_count{};
+  size_t job_chunk{};
+  std::atomic<size_t> next{};
+};
@@ -0,0 +1,238 @@
+#pragma once
+
+#include "chip8.h"
+#include "ring_buffer.h"
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+const uint32_t TRACE_MAGIC = 0x43385452; // "C8TR"
+const uint32_t TRACE_VERSION = 2;
+
+// trace_record_t::reg values besides V0-VF.
+const uint8_t TRACE_INDEX = 0x10;
+const uint8_t TRACE_NO_REGISTER = 0xFF;
+
+/*
+ * Trace file layout: magic u32 and version u32, little-endian, then chunks
+ *
+ *   flags u8, stream varint, records varint, lost varint, size varint,
+ *   payload
+ *
+ * Each chunk holds consecutive records of one stream. Within a payload a
+ * record is the cycle delta from the previous record, the zigzag-encoded
+ * difference between pc and the previous record's pc + 2, the opcode (2
+ * bytes, big endian) and the register byte, then what was written:
+ *
+ *   TRACE_NO_REGISTER   nothing
+ *   TRACE_INDEX         I as a varint
+ *   otherwise           the low nibble is the first register written. With
+ *                       TRACE_RANGE set a byte follows with the last one;
+ *                       the values of the range follow, one byte each, and
+ *                       with TRACE_FLAG set the value of VF after them.
+ *
+ * Integers are varints. The first record of a chunk is relative to zero, so
+ * chunks decode independently. TRACE_CHUNK_ZSTD marks zstd payloads. lost
+ * counts the records dropped right before the chunk.
+ * */
+
+const uint8_t TRACE_CHUNK_ZSTD = 0x01;
+const uint8_t TRACE_RANGE = 0x40;
+const uint8_t TRACE_FLAG = 0x80;
+
+/**
+ * @brief One executed instruction and the registers it wrote, with their
+ * values after it, so a reader can rebuild the register file.
+ *
+ * V(reg) to V(last) were written; a range only for Fx65. flag means VF was
+ * written as well, as a carry, borrow, shifted-out bit or collision. With
+ * x = F the instruction's final VF is the one entry, reg = last = F.
+ */
+struct trace_record_t {
+  uint64_t cycle{};
+  uint16_t pc{};
+  uint16_t opcode{};
+  uint8_t reg = TRACE_NO_REGISTER;
+  uint8_t last{};
+  bool flag{};
+  uint16_t index{};
+  uint8_t registers[REGISTER_COUNT]{}; // by register number
+};
+
+/**
+ * @brief Records of one producing thread.
+ *
+ * record() appends to a small local batch that is handed to the writer
+ * thread through a lock-free ring buffer when full, so the emulation thread
+ * does no I/O and no locking. When the writer falls behind, batches that do
+ * not fit are dropped and counted rather than stalling emulation.
+ */
+class trace_stream_t {
+public:
+  trace_stream_t(uint32_t id, size_t capacity)
+      : id(id), buffer(capacity) {}
+
+  /**
+   * @brief Record the instruction that run_cycle() just executed from pc.
+   */
+  void record(chip8_t const *chip8, uint16_t pc) {
+    auto opcode = chip8->opcode;
+    // Fx0A runs again every cycle until a key lands; only the run that
+    // stores the key is recorded.
+    if ((opcode & 0xF0FFu) == 0xF00Au && chip8->pc == pc) {
+      cycle += 1;
+      return;
+    }
+
+    auto &entry = batch[batched++];
+    entry.cycle = cycle++;
+    entry.pc = pc;
+    entry.opcode = opcode;
+    entry.reg = TRACE_NO_REGISTER;
+    entry.flag = false;
+
+    auto x = static_cast<uint8_t>((opcode & 0x0F00u) >> 8u);
+    switch (opcode >> 12u) {
+    case 0x6:
+    case 0x7:
+    case 0xC:
+      entry.reg = x;
+      break;
+    case 0x8:
+      entry.reg = x;
+      switch (opcode & 0x000Fu) {
+      case 0x4:
+      case 0x5:
+      case 0x6:
+      case 0x7:
+      case 0xE:
+        entry.flag = x != 0xF;
+        break;
+      }
+      break;
+    case 0xA:
+      entry.reg = TRACE_INDEX;
+      break;
+    case 0xD:
+      entry.reg = 0xF;
+      break;
+    case 0xF:
+      switch (opcode & 0x00FFu) {
+      case 0x07:
+      case 0x0A:
+        entry.reg = x;
+        break;
+      case 0x65:
+        entry.reg = 0;
+        break;
+      case 0x1E:
+      case 0x29:
+        entry.reg = TRACE_INDEX;
+        break;
+      }
+      break;
+    }
+    entry.last = (opcode & 0xF0FFu) == 0xF065u ? x : entry.reg;
+    if (entry.reg == TRACE_INDEX)
+      entry.index = chip8->index;
+    else if (entry.reg != TRACE_NO_REGISTER)
+      std::memcpy(entry.registers, chip8->registers, REGISTER_COUNT);
+
+    if (batched == BATCH_SIZE)
+      flush();
+  }
+
+  /**
+   * @brief Hand the local batch to the writer. Call from the producing
+   * thread before the tracer is destroyed.
+   */
+  void flush() {
+    auto pushed = buffer.push(batch, batched);
+    lost.fetch_add(batched - pushed, std::memory_order_relaxed);
+    batched = 0;
+  }
+
+private:
+  friend class tracer_t;
+
+  static const size_t BATCH_SIZE = 256;
+
+  uint32_t id;
+  uint64_t cycle{};
+  trace_record_t batch[BATCH_SIZE];
+  size_t batched{};
+
+  ring_buffer_t<trace_record_t> buffer;
+  std::atomic<uint64_t> lost{};
+  uint64_t lost_reported{}; // writer thread only
+};
+
+/**
+ * @brief Owns the trace file and the background writer thread.
+ */
+class tracer_t {
+public:
+  explicit tracer_t(path_t const &filename, size_t stream_capacity = 1 << 16);
+  ~tracer_t();
+
+  tracer_t(tracer_t const &) = delete;
+  tracer_t &operator=(tracer_t const &) = delete;
+
+  /**
+   * @brief A new stream for one producing thread, owned by the tracer.
+   */
+  trace_stream_t &open_stream();
+
+  uint64_t lost_records() const;
+
+private:
+  void write();
+  bool drain(std::vector<trace_record_t> &records);
+  void write_chunk(trace_stream_t &stream, trace_record_t const *records,
+                   size_t count);
+
+  std::ofstream file;
+  size_t stream_capacity;
+
+  // Encoding buffers, owned by the writer thread.
+  std::vector<uint8_t> payload;
+  std::vector<uint8_t> compressed;
+
+  mutable std::mutex mutex;
+  std::vector<std::unique_ptr<trace_stream_t>> streams;
+
+  std::atomic<bool> closing{};
+  std::thread writer;
+};
+
+/**
+ * @brief Decodes a trace file record by record.
+ */
+class trace_reader_t {
+public:
+  explicit trace_reader_t(path_t const &filename);
+
+  /**
+   * @brief Read the next record and the stream it belongs to.
+   *
+   * @return false at the end of the trace.
+   */
+  bool next(trace_record_t &record, uint32_t &stream);
+
+  uint64_t lost_records() const { return lost; }
+
+private:
+  bool read_chunk();
+
+  std::ifstream file;
+  uint32_t stream{};
+  std::vector<uint8_t> payload;
+  uint8_t const *position{};
+  size_t remaining{};
+  trace_record_t previous;
+  uint32_t expected_pc{};
+  uint64_t lost{};
+};
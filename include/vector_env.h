@@ -0,0 +1,66 @@
+#pragma once
+
+#include "chip8.h"
+#include "machine_pool.h"
+#include "thread_pool.h"
+#include <functional>
+
+/**
+ * @brief A batch of machines running the same ROM, stepped in lockstep.
+ *
+ * The machines live in a machine_pool_t and are reset by copying its image,
+ * taken right after boot, so a reset costs one memcpy instead of
+ * make_chip8() and load_rom(). Steps run on
+ * a thread pool and write their observations into one caller-provided buffer
+ * of size() * PACKED_VIDEO_SIZE bytes, one 1-bpp frame per machine.
+ */
+class vector_env_t {
+public:
+  using reward_fn_t = std::function<float(chip8_t const &)>;
+  using done_fn_t = std::function<bool(chip8_t const &)>;
+
+  vector_env_t(char const *filename, size_t count,
+               unsigned int threads = std::thread::hardware_concurrency());
+
+  vector_env_t &set_cycles_per_frame(unsigned int cycles);
+  vector_env_t &set_reward(reward_fn_t reward);
+  vector_env_t &set_done(done_fn_t done);
+
+  /**
+   * @brief Base seed of the machines' Cxkk generators. Every reset reseeds
+   * a machine from it, its index and its episode count, so episodes differ
+   * from each other and a fixed seed reproduces a run. Takes effect from
+   * the next reset.
+   */
+  vector_env_t &set_seed(uint32_t seed);
+  uint32_t seed() const { return arena.seed(); }
+
+  void reset();
+  void reset(size_t env);
+
+  /**
+   * @brief Hold the keys in actions[i] (bit k = key k) on machine i for the
+   * given number of frames, then observe it.
+   *
+   * rewards and dones may be null. A machine whose done hook fires is reset
+   * after its observation is written, so the observation shows the final
+   * frame and the next step starts a new episode.
+   */
+  void step(uint16_t const *actions, unsigned int frames,
+            uint8_t *observations, float *rewards = nullptr,
+            uint8_t *dones = nullptr);
+
+  void observe(uint8_t *observations) const;
+
+  size_t size() const { return machines.size(); }
+  chip8_t const &machine(size_t env) const { return *machines[env]; }
+
+private:
+  machine_pool_t arena;
+  std::vector<chip8_t *> machines;
+  thread_pool_t pool;
+
+  unsigned int cycles_per_frame = CYCLES_PER_FRAME;
+  reward_fn_t reward;
+  done_fn_t done;
+};
@@ -1,3 +1,4 @@
+#include "latency.h"
 #include <GL/gl.h>
 #include <SDL2/SDL.h>
 #include <cstdint>
@@ -21,6 +22,7 @@ public:
   viewer_t &set_texture_width(int width);
   viewer_t &set_texture_height(int height);
   viewer_t &set_window_scale(int scale);
+  viewer_t &set_latency_tracer(latency_tracer_t *tracer);
 
 private:
   SDL_Window *window{};
@@ -34,6 +36,8 @@ private:
 
   int texture_width{};
   int texture_height{};
+
+  latency_tracer_t *latency{};
 };
 
 #endif // CHIP8_INTERPRETER_PLATFORM_H
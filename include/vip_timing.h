@@ -0,0 +1,58 @@
+#pragma once
+
+#include "chip8.h"
+
+// The VIP's 1802 runs at 1.7609 MHz with 8 clocks per machine cycle, and the
+// CDP1861 interrupts at 60 Hz: about 3668 machine cycles per frame. Display
+// DMA steals 1024 of them (128 lines of 8 bytes) and the interrupt routine,
+// which also decrements the timers, about 44 more.
+const unsigned int VIP_CYCLES_PER_FRAME = 3668;
+const unsigned int VIP_DISPLAY_CYCLES = 1024 + 44;
+const unsigned int VIP_FRAME_BUDGET =
+    VIP_CYCLES_PER_FRAME - VIP_DISPLAY_CYCLES;
+
+/**
+ * @brief Machine cycles the VIP interpreter spends on opcode, including its
+ * fetch and decode loop, given the state right before it runs. Costs that
+ * depend on the outcome, such as a taken skip, are added by the caller.
+ *
+ * The figures are approximations from published disassemblies of the VIP
+ * interpreter; Dxyn only covers drawing, the wait for vblank is modelled by
+ * vip_clock_t.
+ */
+unsigned int vip_cycles(chip8_t const *chip8, uint16_t opcode);
+
+const unsigned int VIP_SKIP_CYCLES = 8;
+
+/**
+ * @brief Cycle-accounted scheduler for the COSMAC VIP timing mode.
+ *
+ * Frames are not a fixed number of instructions. run_frame() ticks the
+ * timers, as the vblank interrupt does, adds one frame's worth of cycles to
+ * the budget and executes instructions until it is spent. An instruction
+ * that overruns the budget is paid for by the next frame, but the debt is
+ * capped below one frame's budget: 00E0 alone costs more than a frame, and
+ * every frame still runs at least one instruction. Dxyn waits for
+ * vblank: it ends the frame, forfeiting the cycles left, and draws at the
+ * start of the next one.
+ *
+ * This is a separate loop around step_instruction() so run_cycle() and the
+ * default frontend pay nothing for it.
+ */
+class vip_clock_t {
+public:
+  /**
+   * @brief Run one 60 Hz frame.
+   *
+   * @return The number of instructions executed.
+   */
+  unsigned int run_frame(chip8_t *chip8);
+
+  uint64_t cycles() const { return total_cycles; }
+  uint64_t frames() const { return total_frames; }
+
+private:
+  int64_t budget{};
+  uint64_t total_cycles{};
+  uint64_t total_frames{};
+};
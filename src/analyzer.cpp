@@ -0,0 +1,576 @@
+#include "analyzer.h"
+#include <cstdio>
+
+static uint8_t make_vx(uint16_t opcode) { return ((opcode & 0x0F00u) >> 8u); }
+
+static uint8_t make_vy(uint16_t opcode) { return ((opcode & 0x00F0u) >> 4u); }
+
+static uint8_t make_kk(uint16_t opcode) { return (opcode & 0x00FFu); }
+
+static uint16_t make_nnn(uint16_t opcode) { return (opcode & 0x0FFFu); }
+
+static std::string hex(unsigned int value, int digits,
+                       char const *prefix = "") {
+  char buffer[16];
+  std::snprintf(buffer, sizeof(buffer), "%s%0*X", prefix, digits, value);
+  return buffer;
+}
+
+/*
+ * Mirrors init_dispatch_table(): the first nibble selects the handler, the 0,
+ * 8 and E groups are then indexed by the last nibble and the F group by the
+ * last byte. Every slot the dispatcher leaves at op_null decodes to op_null.
+ * */
+op_t decode(uint16_t opcode) {
+  switch ((opcode & 0xF000u) >> 12u) {
+  case 0x0:
+    switch (opcode & 0x000Fu) {
+    case 0x0:
+      return op_t::op_00E0;
+    case 0xE:
+      return op_t::op_00EE;
+    default:
+      return op_t::op_null;
+    }
+  case 0x1:
+    return op_t::op_1nnn;
+  case 0x2:
+    return op_t::op_2nnn;
+  case 0x3:
+    return op_t::op_3xkk;
+  case 0x4:
+    return op_t::op_4xkk;
+  case 0x5:
+    return op_t::op_5xy0;
+  case 0x6:
+    return op_t::op_6xkk;
+  case 0x7:
+    return op_t::op_7xkk;
+  case 0x8:
+    switch (opcode & 0x000Fu) {
+    case 0x0:
+      return op_t::op_8xy0;
+    case 0x1:
+      return op_t::op_8xy1;
+    case 0x2:
+      return op_t::op_8xy2;
+    case 0x3:
+      return op_t::op_8xy3;
+    case 0x4:
+      return op_t::op_8xy4;
+    case 0x5:
+      return op_t::op_8xy5;
+    case 0x6:
+      return op_t::op_8xy6;
+    case 0x7:
+      return op_t::op_8xy7;
+    case 0xE:
+      return op_t::op_8xyE;
+    default:
+      return op_t::op_null;
+    }
+  case 0x9:
+    return op_t::op_9xy0;
+  case 0xA:
+    return op_t::op_Annn;
+  case 0xB:
+    return op_t::op_Bnnn;
+  case 0xC:
+    return op_t::op_Cxkk;
+  case 0xD:
+    return op_t::op_Dxyn;
+  case 0xE:
+    switch (opcode & 0x000Fu) {
+    case 0x1:
+      return op_t::op_ExA1;
+    case 0xE:
+      return op_t::op_Ex9E;
+    default:
+      return op_t::op_null;
+    }
+  default:
+    switch (opcode & 0x00FFu) {
+    case 0x02:
+      return op_t::op_F002;
+    case 0x07:
+      return op_t::op_Fx07;
+    case 0x0A:
+      return op_t::op_Fx0A;
+    case 0x15:
+      return op_t::op_Fx15;
+    case 0x18:
+      return op_t::op_Fx18;
+    case 0x1E:
+      return op_t::op_Fx1E;
+    case 0x29:
+      return op_t::op_Fx29;
+    case 0x33:
+      return op_t::op_Fx33;
+    case 0x3A:
+      return op_t::op_Fx3A;
+    case 0x55:
+      return op_t::op_Fx55;
+    case 0x65:
+      return op_t::op_Fx65;
+    default:
+      return op_t::op_null;
+    }
+  }
+}
+
+std::string disassemble(uint16_t opcode) {
+  auto vx = hex(make_vx(opcode), 1, "V");
+  auto vy = hex(make_vy(opcode), 1, "V");
+  auto kk = hex(make_kk(opcode), 2, "0x");
+  auto nnn = hex(make_nnn(opcode), 3, "0x");
+
+  switch (decode(opcode)) {
+  case op_t::op_00E0:
+    return "CLS";
+  case op_t::op_00EE:
+    return "RET";
+  case op_t::op_1nnn:
+    return "JP " + nnn;
+  case op_t::op_2nnn:
+    return "CALL " + nnn;
+  case op_t::op_3xkk:
+    return "SE " + vx + ", " + kk;
+  case op_t::op_4xkk:
+    return "SNE " + vx + ", " + kk;
+  case op_t::op_5xy0:
+    return "SE " + vx + ", " + vy;
+  case op_t::op_6xkk:
+    return "LD " + vx + ", " + kk;
+  case op_t::op_7xkk:
+    return "ADD " + vx + ", " + kk;
+  case op_t::op_8xy0:
+    return "LD " + vx + ", " + vy;
+  case op_t::op_8xy1:
+    return "OR " + vx + ", " + vy;
+  case op_t::op_8xy2:
+    return "AND " + vx + ", " + vy;
+  case op_t::op_8xy3:
+    return "XOR " + vx + ", " + vy;
+  case op_t::op_8xy4:
+    return "ADD " + vx + ", " + vy;
+  case op_t::op_8xy5:
+    return "SUB " + vx + ", " + vy;
+  case op_t::op_8xy6:
+    return "SHR " + vx;
+  case op_t::op_8xy7:
+    return "SUBN " + vx + ", " + vy;
+  case op_t::op_8xyE:
+    return "SHL " + vx;
+  case op_t::op_9xy0:
+    return "SNE " + vx + ", " + vy;
+  case op_t::op_Annn:
+    return "LD I, " + nnn;
+  case op_t::op_Bnnn:
+    return "JP V0, " + nnn;
+  case op_t::op_Cxkk:
+    return "RND " + vx + ", " + kk;
+  case op_t::op_Dxyn:
+    return "DRW " + vx + ", " + vy + ", " + hex(opcode & 0x000Fu, 1);
+  case op_t::op_Ex9E:
+    return "SKP " + vx;
+  case op_t::op_ExA1:
+    return "SKNP " + vx;
+  case op_t::op_F002:
+    return "AUDIO";
+  case op_t::op_Fx07:
+    return "LD " + vx + ", DT";
+  case op_t::op_Fx0A:
+    return "LD " + vx + ", K";
+  case op_t::op_Fx15:
+    return "LD DT, " + vx;
+  case op_t::op_Fx18:
+    return "LD ST, " + vx;
+  case op_t::op_Fx1E:
+    return "ADD I, " + vx;
+  case op_t::op_Fx29:
+    return "LD F, " + vx;
+  case op_t::op_Fx33:
+    return "LD B, " + vx;
+  case op_t::op_Fx3A:
+    return "PITCH " + vx;
+  case op_t::op_Fx55:
+    return "LD [I], " + vx;
+  case op_t::op_Fx65:
+    return "LD " + vx + ", [I]";
+  case op_t::op_null:
+    break;
+  }
+  return "DW 0x" + hex(opcode, 4);
+}
+
+static uint16_t read_opcode(uint8_t const *memory, uint16_t address) {
+  return static_cast<uint16_t>((memory[address] << 8u) | memory[address + 1]);
+}
+
+static bool is_skip(op_t op) {
+  switch (op) {
+  case op_t::op_3xkk:
+  case op_t::op_4xkk:
+  case op_t::op_5xy0:
+  case op_t::op_9xy0:
+  case op_t::op_Ex9E:
+  case op_t::op_ExA1:
+    return true;
+  default:
+    return false;
+  }
+}
+
+static bool ends_block(op_t op) {
+  switch (op) {
+  case op_t::op_00EE:
+  case op_t::op_1nnn:
+  case op_t::op_2nnn:
+  case op_t::op_Bnnn:
+    return true;
+  default:
+    return is_skip(op);
+  }
+}
+
+static bool is_decodable(uint16_t address) {
+  return address < MEMORY_SIZE - 1;
+}
+
+/**
+ * @brief Addresses control can reach after executing the instruction at
+ * address. Returns and indirect jumps have no static successors.
+ */
+static std::vector<uint16_t> successors_of(uint16_t address, uint16_t opcode) {
+  auto next = static_cast<uint16_t>(address + 2);
+  switch (decode(opcode)) {
+  case op_t::op_00EE:
+  case op_t::op_Bnnn:
+    return {};
+  case op_t::op_1nnn:
+    return {make_nnn(opcode)};
+  case op_t::op_2nnn:
+    return {make_nnn(opcode), next};
+  default:
+    if (is_skip(decode(opcode)))
+      return {next, static_cast<uint16_t>(address + 4)};
+    return {next};
+  }
+}
+
+static void trace_code(analysis_t &analysis, uint8_t const *memory,
+                       std::set<uint16_t> &leaders) {
+  std::vector<uint16_t> worklist{analysis.entry};
+  leaders.insert(analysis.entry);
+
+  while (!worklist.empty()) {
+    auto address = worklist.back();
+    worklist.pop_back();
+    if (!is_decodable(address) || analysis.instructions[address])
+      continue;
+
+    analysis.instructions.set(address);
+    analysis.code.set(address);
+    analysis.code.set(address + 1u);
+
+    auto opcode = read_opcode(memory, address);
+    auto op = decode(opcode);
+    auto successors = successors_of(address, opcode);
+
+    if (op == op_t::op_2nnn)
+      analysis.subroutines.insert(make_nnn(opcode));
+    if (op == op_t::op_Bnnn)
+      analysis.indirect_jumps.push_back(address);
+    if (ends_block(op))
+      leaders.insert(successors.begin(), successors.end());
+
+    worklist.insert(worklist.end(), successors.begin(), successors.end());
+  }
+}
+
+static void build_blocks(analysis_t &analysis, uint8_t const *memory,
+                         std::set<uint16_t> const &leaders) {
+  for (auto leader : leaders) {
+    if (!is_decodable(leader) || !analysis.instructions[leader])
+      continue;
+
+    basic_block_t block;
+    block.start = leader;
+
+    auto address = leader;
+    while (true) {
+      auto opcode = read_opcode(memory, address);
+      auto op = decode(opcode);
+      auto next = static_cast<uint16_t>(address + 2);
+
+      if (ends_block(op)) {
+        block.successors = successors_of(address, opcode);
+        block.returns = op == op_t::op_00EE;
+        block.indirect = op == op_t::op_Bnnn;
+        address = next;
+        break;
+      }
+
+      address = next;
+      if (!is_decodable(address) || !analysis.instructions[address])
+        break;
+      if (leaders.count(address)) {
+        block.successors = {address};
+        break;
+      }
+    }
+
+    block.end = address;
+    analysis.blocks.emplace(leader, block);
+  }
+}
+
+/**
+ * @brief What is statically known about I at a program point.
+ */
+struct index_state_t {
+  enum class kind_t : uint8_t { unset, known, unknown };
+
+  kind_t kind = kind_t::unset;
+  uint16_t value{};
+
+  bool merge(index_state_t const &other) {
+    if (other.kind == kind_t::unset || kind == kind_t::unknown)
+      return false;
+    if (kind == kind_t::unset) {
+      *this = other;
+      return true;
+    }
+    if (other.kind == kind_t::known && other.value == value)
+      return false;
+    kind = kind_t::unknown;
+    return true;
+  }
+};
+
+static index_state_t unknown_index() {
+  return {index_state_t::kind_t::unknown, 0};
+}
+
+static void step_index(index_state_t &state, uint16_t opcode) {
+  auto op = decode(opcode);
+  if (op == op_t::op_Annn)
+    state = {index_state_t::kind_t::known, make_nnn(opcode)};
+  else if (op == op_t::op_Fx1E || op == op_t::op_Fx29)
+    state = unknown_index();
+}
+
+/*
+ * Fx33 and Fx55 are the only instructions that store into guest memory. The
+ * store address is resolved by propagating I from Annn instructions along the
+ * control-flow graph; anything else that changes I, or two paths that disagree
+ * about it, makes the target unknown. A subroutine may change I, so the return
+ * site of a call starts out unknown.
+ * */
+static void find_writes(analysis_t &analysis, uint8_t const *memory) {
+  std::map<uint16_t, index_state_t> entry_state;
+  entry_state[analysis.entry] = unknown_index();
+
+  std::vector<uint16_t> worklist{analysis.entry};
+  while (!worklist.empty()) {
+    auto start = worklist.back();
+    worklist.pop_back();
+
+    auto found = analysis.blocks.find(start);
+    if (found == analysis.blocks.end())
+      continue;
+    auto const &block = found->second;
+
+    auto state = entry_state[start];
+    for (auto address = start; address < block.end; address += 2)
+      step_index(state, read_opcode(memory, address));
+
+    auto last = static_cast<uint16_t>(block.end - 2);
+    bool call = decode(read_opcode(memory, last)) == op_t::op_2nnn;
+    for (auto successor : block.successors) {
+      auto incoming = state;
+      if (call && successor == block.end)
+        incoming = unknown_index();
+      if (entry_state[successor].merge(incoming))
+        worklist.push_back(successor);
+    }
+  }
+
+  for (auto &[start, block] : analysis.blocks) {
+    auto state = entry_state[start];
+    if (state.kind == index_state_t::kind_t::unset)
+      state = unknown_index();
+
+    for (auto address = start; address < block.end; address += 2) {
+      auto opcode = read_opcode(memory, address);
+      auto op = decode(opcode);
+
+      if (op == op_t::op_Fx33 || op == op_t::op_Fx55) {
+        memory_write_t write;
+        write.pc = address;
+        write.opcode = opcode;
+        write.known = state.kind == index_state_t::kind_t::known;
+        if (write.known) {
+          auto length = op == op_t::op_Fx33 ? 3u : make_vx(opcode) + 1u;
+          write.first = state.value;
+          write.last = static_cast<uint16_t>(state.value + length - 1);
+          for (unsigned int i = write.first; i <= write.last; ++i) {
+            if (i < MEMORY_SIZE && analysis.code[i])
+              write.hits_code = true;
+          }
+        }
+        block.self_modifying |= write.hits_code;
+        analysis.writes.push_back(write);
+      }
+
+      step_index(state, opcode);
+    }
+  }
+}
+
+analysis_t analyze(uint8_t const *memory, uint16_t rom_end, uint16_t entry) {
+  analysis_t analysis;
+  analysis.entry = entry;
+  analysis.rom_end = rom_end;
+
+  std::set<uint16_t> leaders;
+  trace_code(analysis, memory, leaders);
+  build_blocks(analysis, memory, leaders);
+  find_writes(analysis, memory);
+  return analysis;
+}
+
+static std::string label_of(analysis_t const &analysis, uint16_t address) {
+  if (analysis.subroutines.count(address))
+    return "sub_" + hex(address, 3);
+  return "L_" + hex(address, 3);
+}
+
+using range_t = std::pair<uint16_t, uint16_t>;
+
+/**
+ * @brief Split [PROGRAM_START_ADDRESS, rom_end) into runs of code or data.
+ */
+static std::vector<range_t> ranges_of(analysis_t const &analysis, bool code) {
+  std::vector<range_t> ranges;
+  for (unsigned int i = PROGRAM_START_ADDRESS; i < analysis.rom_end; ++i) {
+    if (analysis.code[i] != code)
+      continue;
+    auto address = static_cast<uint16_t>(i);
+    if (!ranges.empty() && ranges.back().second == address)
+      ranges.back().second = static_cast<uint16_t>(address + 1);
+    else
+      ranges.emplace_back(address, static_cast<uint16_t>(address + 1));
+  }
+  return ranges;
+}
+
+void write_text(std::ostream &out, analysis_t const &analysis,
+                uint8_t const *memory) {
+  out << "; entry 0x" << hex(analysis.entry, 3) << ", "
+      << analysis.blocks.size() << " blocks, " << analysis.subroutines.size()
+      << " subroutines\n";
+
+  for (auto const &[start, block] : analysis.blocks) {
+    out << "\n" << label_of(analysis, start) << ":";
+    if (block.self_modifying)
+      out << "  ; writes into code";
+    out << "\n";
+
+    for (auto address = start; address < block.end; address += 2) {
+      auto opcode = read_opcode(memory, address);
+      out << "  0x" << hex(address, 3) << "  " << hex(opcode, 4) << "  "
+          << disassemble(opcode) << "\n";
+    }
+
+    if (block.returns)
+      out << "  ; return\n";
+    else if (block.indirect)
+      out << "  ; indirect jump\n";
+    else if (!block.successors.empty()) {
+      out << "  ; ->";
+      for (auto successor : block.successors)
+        out << " " << label_of(analysis, successor);
+      out << "\n";
+    }
+  }
+
+  auto data = ranges_of(analysis, false);
+  if (!data.empty())
+    out << "\n";
+  for (auto const &[first, end] : data)
+    out << "; data 0x" << hex(first, 3) << "-0x" << hex(end - 1u, 3) << " ("
+        << end - first << " bytes)\n";
+
+  for (auto const &write : analysis.writes) {
+    if (!write.known)
+      out << "; 0x" << hex(write.pc, 3) << " " << disassemble(write.opcode)
+          << " writes to an unknown address\n";
+    else if (write.hits_code)
+      out << "; 0x" << hex(write.pc, 3) << " " << disassemble(write.opcode)
+          << " modifies code at 0x" << hex(write.first, 3) << "-0x"
+          << hex(write.last, 3) << "\n";
+  }
+}
+
+template <typename T>
+static void write_json_array(std::ostream &out, T const &values) {
+  out << "[";
+  bool first = true;
+  for (auto value : values) {
+    out << (first ? "" : ",") << value;
+    first = false;
+  }
+  out << "]";
+}
+
+static void write_json_ranges(std::ostream &out,
+                              std::vector<range_t> const &ranges) {
+  out << "[";
+  for (size_t i = 0; i < ranges.size(); ++i)
+    out << (i ? "," : "") << "[" << ranges[i].first << ","
+        << ranges[i].second << "]";
+  out << "]";
+}
+
+void write_json(std::ostream &out, analysis_t const &analysis) {
+  out << "{\"entry\":" << analysis.entry << ",\"rom_end\":" << analysis.rom_end;
+
+  out << ",\"blocks\":[";
+  bool first = true;
+  for (auto const &[start, block] : analysis.blocks) {
+    out << (first ? "" : ",") << "{\"start\":" << start
+        << ",\"end\":" << block.end << ",\"successors\":";
+    write_json_array(out, block.successors);
+    out << ",\"returns\":" << (block.returns ? "true" : "false")
+        << ",\"indirect\":" << (block.indirect ? "true" : "false")
+        << ",\"self_modifying\":" << (block.self_modifying ? "true" : "false")
+        << "}";
+    first = false;
+  }
+  out << "]";
+
+  out << ",\"subroutines\":";
+  write_json_array(out, analysis.subroutines);
+  out << ",\"indirect_jumps\":";
+  write_json_array(out, analysis.indirect_jumps);
+
+  out << ",\"writes\":[";
+  for (size_t i = 0; i < analysis.writes.size(); ++i) {
+    auto const &write = analysis.writes[i];
+    out << (i ? "," : "") << "{\"pc\":" << write.pc
+        << ",\"opcode\":" << write.opcode
+        << ",\"known\":" << (write.known ? "true" : "false");
+    if (write.known)
+      out << ",\"first\":" << write.first << ",\"last\":" << write.last
+          << ",\"hits_code\":" << (write.hits_code ? "true" : "false");
+    out << "}";
+  }
+  out << "]";
+
+  out << ",\"code\":";
+  write_json_ranges(out, ranges_of(analysis, true));
+  out << ",\"data\":";
+  write_json_ranges(out, ranges_of(analysis, false));
+  out << "}\n";
+}
@@ -0,0 +1,415 @@
+#include "aot.h"
+#include "analyzer.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <dlfcn.h>
+#include <sstream>
+#include <sys/wait.h>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+
+static uint8_t make_vx(uint16_t opcode) { return ((opcode & 0x0F00u) >> 8u); }
+
+static uint8_t make_vy(uint16_t opcode) { return ((opcode & 0x00F0u) >> 4u); }
+
+static uint8_t make_kk(uint16_t opcode) { return (opcode & 0x00FFu); }
+
+static uint16_t make_nnn(uint16_t opcode) { return (opcode & 0x0FFFu); }
+
+static std::string hex(unsigned int value) {
+  char buffer[16];
+  std::snprintf(buffer, sizeof(buffer), "0x%X", value);
+  return buffer;
+}
+
+uint64_t hash_memory(uint8_t const *memory) {
+  uint64_t hash = 0xcbf29ce484222325u;
+  for (unsigned int i = 0; i < MEMORY_SIZE; ++i) {
+    hash ^= memory[i];
+    hash *= 0x100000001b3u;
+  }
+  return hash;
+}
+
+static uint16_t read_opcode(uint8_t const *memory, uint16_t address) {
+  return static_cast<uint16_t>((memory[address] << 8u) | memory[address + 1]);
+}
+
+/**
+ * @brief Instructions after which a recompiled block has to return to the
+ * host: Fx0A may rewind pc and Fx33/Fx55 may overwrite recompiled code.
+ */
+static bool splits_block(op_t op) {
+  return op == op_t::op_Fx0A || op == op_t::op_Fx33 || op == op_t::op_Fx55;
+}
+
+/*
+ * Emits the body of one block. Timer updates are batched: run_cycle() ticks
+ * both timers after every instruction, and since nothing but Fx07, Fx15, Fx18
+ * and the host handlers observe them, the pending ticks are only applied
+ * before those and at the end of the block.
+ * */
+class block_writer_t {
+public:
+  block_writer_t(std::ostream &out, uint8_t const *memory)
+      : out(out), memory(memory) {}
+
+  void write(uint16_t start, uint16_t end) {
+    out << "\nstatic unsigned int block_" << std::hex << start << std::dec
+        << "(chip8_t *c) {\n";
+
+    unsigned int count = 0;
+    bool jumped = false;
+    uint16_t opcode = 0;
+    for (uint16_t address = start; address < end; address += 2) {
+      opcode = read_opcode(memory, address);
+      out << "  // " << hex(address) << ": " << disassemble(opcode) << "\n";
+      jumped = instruction(address, opcode);
+      pending += 1;
+      count += 1;
+    }
+
+    flush();
+    if (!jumped)
+      out << "  c->pc = " << hex(end) << ";\n";
+    out << "  c->opcode = " << hex(opcode) << ";\n";
+    out << "  return " << count << ";\n}\n";
+  }
+
+private:
+  void flush() {
+    if (pending)
+      out << "  tick(c, " << pending << ");\n";
+    pending = 0;
+  }
+
+  void host(uint16_t address, uint16_t opcode) {
+    flush();
+    out << "  c->pc = " << hex(address + 2u) << ";\n";
+    out << "  host.execute(c, " << hex(opcode) << ");\n";
+  }
+
+  void skip(uint16_t address, std::string const &condition) {
+    out << "  c->pc = (" << condition << ") ? " << hex(address + 4u) << " : "
+        << hex(address + 2u) << ";\n";
+  }
+
+  // Returns true when the instruction sets pc itself.
+  bool instruction(uint16_t address, uint16_t opcode) {
+    auto vx = "c->registers[" + hex(make_vx(opcode)) + "]";
+    auto vy = "c->registers[" + hex(make_vy(opcode)) + "]";
+    auto vf = std::string("c->registers[0xF]");
+    auto kk = hex(make_kk(opcode));
+    auto nnn = hex(make_nnn(opcode));
+
+    switch (decode(opcode)) {
+    case op_t::op_00E0:
+      out << "  std::memset(c->video, 0, sizeof(c->video));\n";
+      return false;
+    case op_t::op_00EE:
+      out << "  c->sp -= 1;\n  c->pc = c->stack[c->sp];\n";
+      return true;
+    case op_t::op_1nnn:
+      out << "  c->pc = " << nnn << ";\n";
+      return true;
+    case op_t::op_2nnn:
+      out << "  c->stack[c->sp] = " << hex(address + 2u) << ";\n"
+          << "  c->sp += 1;\n  c->pc = " << nnn << ";\n";
+      return true;
+    case op_t::op_3xkk:
+      skip(address, vx + " == " + kk);
+      return true;
+    case op_t::op_4xkk:
+      skip(address, vx + " != " + kk);
+      return true;
+    case op_t::op_5xy0:
+      skip(address, vx + " == " + vy);
+      return true;
+    case op_t::op_9xy0:
+      skip(address, vx + " != " + vy);
+      return true;
+    case op_t::op_6xkk:
+      out << "  " << vx << " = " << kk << ";\n";
+      return false;
+    case op_t::op_7xkk:
+      out << "  " << vx << " += " << kk << ";\n";
+      return false;
+    case op_t::op_8xy0:
+      out << "  " << vx << " = " << vy << ";\n";
+      return false;
+    case op_t::op_8xy1:
+      out << "  " << vx << " |= " << vy << ";\n";
+      return false;
+    case op_t::op_8xy2:
+      out << "  " << vx << " &= " << vy << ";\n";
+      return false;
+    case op_t::op_8xy3:
+      out << "  " << vx << " ^= " << vy << ";\n";
+      return false;
+    case op_t::op_8xy4:
+      out << "  {\n    unsigned int sum = " << vx << " + " << vy << ";\n"
+          << "    " << vf << " = sum > 255u;\n"
+          << "    " << vx << " = static_cast<uint8_t>(sum);\n  }\n";
+      return false;
+    case op_t::op_8xy5:
+      out << "  " << vf << " = " << vx << " > " << vy << ";\n"
+          << "  " << vx << " -= " << vy << ";\n";
+      return false;
+    case op_t::op_8xy6:
+      out << "  " << vf << " = " << vx << " & 0x1u;\n"
+          << "  " << vx << " >>= 1;\n";
+      return false;
+    case op_t::op_8xy7:
+      out << "  " << vf << " = " << vy << " > " << vx << ";\n"
+          << "  " << vx << " = static_cast<uint8_t>(" << vy << " - " << vx
+          << ");\n";
+      return false;
+    case op_t::op_8xyE:
+      out << "  " << vf << " = (" << vx << " & 0x80u) >> 7u;\n"
+          << "  " << vx << " <<= 1;\n";
+      return false;
+    case op_t::op_Annn:
+      out << "  c->index = " << nnn << ";\n";
+      return false;
+    case op_t::op_Bnnn:
+      out << "  c->pc = static_cast<uint16_t>(c->registers[0] + " << nnn
+          << ");\n";
+      return true;
+    case op_t::op_Fx07:
+      flush();
+      out << "  " << vx << " = c->delay_timer;\n";
+      return false;
+    case op_t::op_Fx15:
+      flush();
+      out << "  c->delay_timer = " << vx << ";\n";
+      return false;
+    case op_t::op_Fx18:
+      flush();
+      out << "  c->sound_timer = " << vx << ";\n";
+      return false;
+    case op_t::op_Fx1E:
+      out << "  c->index = (c->index + " << vx << ") & " << hex(MEMORY_MASK)
+          << ";\n";
+      return false;
+    case op_t::op_Fx29:
+      out << "  c->index = static_cast<uint16_t>(" << hex(FONTSET_START_ADDRESS)
+          << " + 5 * " << vx << ");\n";
+      return false;
+    case op_t::op_Fx3A:
+      out << "  c->audio_pitch = " << vx << ";\n";
+      return false;
+    case op_t::op_null:
+      return false;
+    case op_t::op_Ex9E:
+    case op_t::op_ExA1:
+    case op_t::op_Fx0A:
+      host(address, opcode);
+      return true;
+    default:
+      host(address, opcode);
+      return false;
+    }
+  }
+
+  std::ostream &out;
+  uint8_t const *memory;
+  unsigned int pending{};
+};
+
+std::string translate(analysis_t const &analysis, uint8_t const *memory) {
+  std::bitset<MEMORY_SIZE> overwritten;
+  for (auto const &write : analysis.writes) {
+    for (unsigned int i = write.first; write.hits_code && i <= write.last; ++i)
+      if (i < MEMORY_SIZE)
+        overwritten.set(i);
+  }
+
+  // Split the analyzer's blocks wherever the recompiled code must hand
+  // control back to the host, and drop blocks the ROM itself overwrites.
+  std::vector<std::pair<uint16_t, uint16_t>> ranges;
+  for (auto const &[start, block] : analysis.blocks) {
+    bool modified = false;
+    for (unsigned int i = start; i < block.end; ++i)
+      modified |= overwritten[i];
+    if (modified)
+      continue;
+
+    auto first = start;
+    for (uint16_t address = start; address < block.end; address += 2) {
+      if (splits_block(decode(read_opcode(memory, address)))) {
+        ranges.emplace_back(first, static_cast<uint16_t>(address + 2));
+        first = static_cast<uint16_t>(address + 2);
+      }
+    }
+    if (first < block.end)
+      ranges.emplace_back(first, block.end);
+  }
+
+  std::ostringstream out;
+  out << "// Generated by chip8_aot. Do not edit.\n"
+      << "#include \"aot.h\"\n"
+      << "#include <cstring>\n\n"
+      << "static aot_host_t host;\n\n"
+      << "static inline void tick(chip8_t *c, unsigned int n) {\n"
+      << "  c->delay_timer = c->delay_timer > n ? "
+         "static_cast<uint8_t>(c->delay_timer - n) : 0;\n"
+      << "  c->sound_timer = c->sound_timer > n ? "
+         "static_cast<uint8_t>(c->sound_timer - n) : 0;\n"
+      << "}\n";
+
+  block_writer_t writer(out, memory);
+  for (auto const &[start, end] : ranges)
+    writer.write(start, end);
+
+  out << "\nextern \"C\" {\n"
+      << "extern const uint64_t chip8_aot_rom_hash = " << hash_memory(memory)
+      << "u;\n"
+      << "extern const uint64_t chip8_aot_layout = aot_layout();\n"
+      << "extern const aot_block_t chip8_aot_blocks[] = {\n";
+  for (auto const &[start, end] : ranges)
+    out << "    {" << hex(start) << ", " << hex(end) << ", block_" << std::hex
+        << start << std::dec << "},\n";
+  out << "};\n"
+      << "extern const size_t chip8_aot_block_count = " << ranges.size()
+      << ";\n"
+      << "void chip8_aot_bind(aot_host_t const *bound) { host = *bound; }\n"
+      << "}\n";
+
+  return out.str();
+}
+
+void compile_module(path_t const &source, path_t const &output,
+                    path_t const &include_dir) {
+  // $CXX may hold a launcher or flags ("ccache g++"); split it on spaces as
+  // make does. Everything else is passed as is, no shell in between.
+  auto compiler = std::getenv("CXX");
+  std::istringstream words(compiler ? compiler : "");
+  std::vector<std::string> args;
+  for (std::string word; words >> word;)
+    args.push_back(word);
+  if (args.empty())
+    args.push_back("c++");
+  for (auto const *flag : {"-std=c++20", "-O2", "-shared", "-fPIC"})
+    args.push_back(flag);
+  args.push_back("-I" + include_dir.string());
+  args.push_back(source.string());
+  args.push_back("-o");
+  args.push_back(output.string());
+
+  std::vector<char *> argv;
+  for (auto &arg : args)
+    argv.push_back(arg.data());
+  argv.push_back(nullptr);
+
+  auto pid = fork();
+  if (pid < 0)
+    throw std::system_error(errno, std::generic_category(), "fork");
+  if (pid == 0) {
+    execvp(argv[0], argv.data());
+    std::perror(argv[0]);
+    _exit(127);
+  }
+
+  int status = 0;
+  while (waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR)
+      throw std::system_error(errno, std::generic_category(), "waitpid");
+  }
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    throw std::runtime_error("Failed to compile " + source.string() + ".");
+}
+
+aot_module_t::~aot_module_t() {
+  if (handle != nullptr)
+    dlclose(handle);
+}
+
+template <typename T> static T lookup(void *handle, char const *name) {
+  auto symbol = dlsym(handle, name);
+  if (symbol == nullptr)
+    throw std::runtime_error(dlerror());
+  return reinterpret_cast<T>(symbol);
+}
+
+void aot_module_t::load(path_t const &filename, chip8_t const *chip8) {
+  // dlopen() only treats names containing a slash as paths.
+  auto module = std::filesystem::absolute(filename);
+  handle = dlopen(module.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (handle == nullptr)
+    throw std::runtime_error(dlerror());
+
+  auto layout = lookup<uint64_t const *>(handle, "chip8_aot_layout");
+  if (*layout != aot_layout())
+    throw std::runtime_error(
+        "Recompiled module was built against another chip8_t layout.");
+
+  auto rom_hash = lookup<uint64_t const *>(handle, "chip8_aot_rom_hash");
+  if (*rom_hash != hash_memory(chip8->memory))
+    throw std::runtime_error("Recompiled module was built for another ROM.");
+
+  blocks = lookup<aot_block_t const *>(handle, "chip8_aot_blocks");
+  block_count = *lookup<size_t const *>(handle, "chip8_aot_block_count");
+
+  aot_host_t host{execute_opcode};
+  lookup<void (*)(aot_host_t const *)>(handle, "chip8_aot_bind")(&host);
+
+  for (size_t i = 0; i < block_count; ++i) {
+    entries[blocks[i].start] = &blocks[i];
+    for (unsigned int address = blocks[i].start; address < blocks[i].end;
+         ++address)
+      covered.set(address);
+  }
+}
+
+unsigned int aot_module_t::run(chip8_t *chip8) {
+  unsigned int count = 1;
+
+  auto block = chip8->pc < MEMORY_SIZE ? entries[chip8->pc] : nullptr;
+  if (block != nullptr)
+    count = block->run(chip8);
+  else
+    run_cycle(chip8);
+
+  auto store = chip8->opcode & 0xF0FFu;
+  if (store == 0xF033u || store == 0xF055u)
+    invalidate(chip8);
+
+  return count;
+}
+
+/**
+ * @brief Drop every block the last Fx33/Fx55 wrote into.
+ */
+void aot_module_t::invalidate(chip8_t const *chip8) {
+  auto length = (chip8->opcode & 0x00FFu) == 0x33u
+                    ? 3u
+                    : make_vx(chip8->opcode) + 1u;
+
+  // A store running past the end lands in the mirror of 0..15, so it may
+  // touch two ranges.
+  unsigned int first = chip8->index;
+  unsigned int last = first + length - 1;
+  unsigned int wrapped_last = 0;
+  bool wraps = last >= MEMORY_SIZE;
+  if (wraps) {
+    wrapped_last = last - MEMORY_SIZE;
+    last = MEMORY_SIZE - 1;
+  }
+
+  bool hit = false;
+  for (auto address = first; address <= last; ++address)
+    hit |= covered[address];
+  for (unsigned int address = 0; wraps && address <= wrapped_last; ++address)
+    hit |= covered[address];
+  if (!hit)
+    return;
+
+  for (size_t i = 0; i < block_count; ++i) {
+    auto const &block = blocks[i];
+    if ((block.start <= last && block.end > first) ||
+        (wraps && block.start <= wrapped_last))
+      entries[block.start] = nullptr;
+  }
+}
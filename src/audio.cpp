@@ -0,0 +1,144 @@
+#include "audio.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+void audio_t::build() {
+  if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
+    throw std::runtime_error(SDL_GetError());
+  }
+
+  SDL_AudioSpec wanted{};
+  wanted.freq = sample_rate;
+  wanted.format = AUDIO_S16SYS;
+  wanted.channels = 1;
+  wanted.samples = device_samples;
+  wanted.callback = callback;
+  wanted.userdata = this;
+
+  SDL_AudioSpec obtained{};
+  device = SDL_OpenAudioDevice(nullptr, 0, &wanted, &obtained, 0);
+  if (device == 0) {
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    throw std::runtime_error(SDL_GetError());
+  }
+
+  sample_rate = obtained.freq;
+  device_samples = obtained.samples;
+  if (update_rate > 0) {
+    // The device drains a period's worth of samples between two updates and
+    // may pull a whole buffer just before the next one.
+    auto period_samples = static_cast<size_t>(
+        (sample_rate + update_rate - 1) / update_rate);
+    queue_samples = std::max(queue_samples, period_samples + device_samples);
+  }
+  queue = std::make_unique<ring_buffer_t<int16_t>>(queue_samples);
+
+  SDL_PauseAudioDevice(device, 0);
+}
+
+audio_t::~audio_t() {
+  if (device != 0) {
+    SDL_CloseAudioDevice(device);
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+  }
+}
+
+void audio_t::update(chip8_t const *chip8) {
+  if (!queue)
+    return;
+
+  int16_t samples[256];
+  auto queued = queue->size();
+  while (queued < queue_samples) {
+    auto count = std::min(queue_samples - queued, std::size(samples));
+    for (size_t i = 0; i < count; ++i)
+      samples[i] = next_sample(chip8);
+
+    queued += queue->push(samples, count);
+  }
+}
+
+int16_t audio_t::next_sample(chip8_t const *chip8) {
+  if (chip8->sound_timer == 0) {
+    phase = 0;
+    return 0;
+  }
+
+  if (!chip8->audio_pattern_loaded) {
+    // Plain CHIP-8 buzzer: square wave at the tone frequency.
+    phase += static_cast<double>(tone_frequency) / sample_rate;
+    phase -= std::floor(phase);
+    return phase < 0.5 ? volume : static_cast<int16_t>(-volume);
+  }
+
+  /*
+   * XO-CHIP: the 128-bit pattern is played back one bit at a time at
+   * 4000 * 2 ^ ((pitch - 64) / 48) bits per second.
+   * */
+  auto bits = AUDIO_PATTERN_SIZE * 8;
+  auto rate = 4000.0 * std::exp2((chip8->audio_pitch - 64) / 48.0);
+  phase += rate / sample_rate / bits;
+  phase -= std::floor(phase);
+
+  auto bit = static_cast<unsigned int>(phase * bits) % bits;
+  auto on = chip8->audio_pattern[bit / 8] & (0x80u >> (bit % 8));
+  return on ? volume : static_cast<int16_t>(-volume);
+}
+
+void audio_t::callback(void *userdata, uint8_t *stream, int length) {
+  auto audio = static_cast<audio_t *>(userdata);
+  auto samples = reinterpret_cast<int16_t *>(stream);
+  auto requested = static_cast<size_t>(length) / sizeof(int16_t);
+
+  auto received = audio->queue->pop(samples, requested);
+  if (received < requested) {
+    // The emulation side fell behind: play silence instead of stale data.
+    std::memset(samples + received, 0,
+                (requested - received) * sizeof(int16_t));
+    audio->underruns.fetch_add(1, std::memory_order_relaxed);
+    audio->underrun_samples.fetch_add(requested - received,
+                                      std::memory_order_relaxed);
+  }
+}
+
+audio_stats_t audio_t::stats() const {
+  audio_stats_t result;
+  result.underruns = underruns.load(std::memory_order_relaxed);
+  result.underrun_samples = underrun_samples.load(std::memory_order_relaxed);
+  result.queued_samples = queue ? queue->size() : 0;
+  result.latency_ms =
+      1000.0 * static_cast<double>(result.queued_samples + device_samples) /
+      sample_rate;
+  return result;
+}
+
+audio_t &audio_t::set_sample_rate(int rate) {
+  sample_rate = rate;
+  return *this;
+}
+
+audio_t &audio_t::set_device_samples(uint16_t samples) {
+  device_samples = samples;
+  return *this;
+}
+
+audio_t &audio_t::set_queue_samples(size_t samples) {
+  queue_samples = samples;
+  return *this;
+}
+
+audio_t &audio_t::set_update_rate(int rate) {
+  update_rate = rate;
+  return *this;
+}
+
+audio_t &audio_t::set_tone_frequency(int frequency) {
+  tone_frequency = frequency;
+  return *this;
+}
+
+audio_t &audio_t::set_volume(int16_t volume) {
+  this->volume = volume;
+  return *this;
+}
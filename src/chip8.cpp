@@ -1,10 +1,30 @@
 
 #include "chip8.h"
+#include <chrono>
 #include <fstream>
 
 static void init(chip8_t *chip8);
 static void load_fonset(uint8_t *memory);
 
+static const uint8_t chip8_fontset[FONTSET_SIZE] = {
+    0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+    0x20, 0x60, 0x20, 0x20, 0x70, // 1
+    0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+    0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+    0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+    0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+    0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+    0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+    0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+    0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+    0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+    0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+    0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+    0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+    0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+    0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+};
+
 chip8_ptr_t make_chip8() {
   auto chip8 = std::make_unique<chip8_t>();
   init(chip8.get());
@@ -15,43 +35,23 @@ static void init(chip8_t *chip8) {
   if (chip8 == nullptr)
     return;
 
-  std::memset(chip8->memory, 0, sizeof(chip8->memory));
-  std::memset(chip8->registers, 0, sizeof(chip8->registers));
-  std::memset(chip8->stack, 0, sizeof(chip8->stack));
-  std::memset(chip8->keypad, 0, sizeof(chip8->keypad));
-
+  // make_unique value-initializes the machine, so only the non-zero parts
+  // are set here.
   chip8->pc = PROGRAM_START_ADDRESS;
-  chip8->sp = 0;
-
-  chip8->opcode = 0;
-  chip8->index = 0;
+  chip8->audio_pitch = DEFAULT_AUDIO_PITCH;
 
-  chip8->delay_timer = 0;
-  chip8->sound_timer = 0;
+  auto now = std::chrono::system_clock::now().time_since_epoch().count();
+  seed_random(chip8, static_cast<uint32_t>(now));
 
   load_fonset(chip8->memory);
 }
 
-static void load_fonset(uint8_t *memory) {
-  uint8_t chip8_fontset[FONTSET_SIZE] = {
-      0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-      0x20, 0x60, 0x20, 0x20, 0x70, // 1
-      0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-      0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-      0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-      0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-      0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-      0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-      0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-      0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-      0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-      0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-      0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-      0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-      0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-      0xF0, 0x80, 0xF0, 0x80, 0x80  // F
-  };
+void seed_random(chip8_t *chip8, uint32_t seed) {
+  // xorshift32 never leaves the all-zero state.
+  chip8->random_state = seed != 0 ? seed : 0x2545F491u;
+}
 
+static void load_fonset(uint8_t *memory) {
   std::memcpy(memory + FONTSET_START_ADDRESS, chip8_fontset, FONTSET_SIZE);
 }
 
@@ -71,16 +71,26 @@ void load_rom(chip8_t *chip8, char const *filename) {
 
 static uint16_t fetch(chip8_t *chip8);
 static void decode_and_execute(chip8_t *chip8);
-static void update_timers(chip8_t *chip8);
 
 void run_cycle(chip8_t *chip8) {
+  step_instruction(chip8);
+  tick_timers(chip8);
+}
+
+void step_instruction(chip8_t *chip8) {
   chip8->opcode = fetch(chip8);
   chip8->pc += 2;
   decode_and_execute(chip8);
-  update_timers(chip8);
+}
+
+void execute_opcode(chip8_t *chip8, uint16_t opcode) {
+  chip8->opcode = opcode;
+  decode_and_execute(chip8);
 }
 
 static uint16_t fetch(chip8_t *chip8) {
+  // Wrap pc once per instruction; the memory mirror covers the second byte.
+  chip8->pc &= MEMORY_MASK;
   return static_cast<uint16_t>((chip8->memory[chip8->pc] << 8u) |
                                chip8->memory[chip8->pc + 1]);
 }
@@ -93,13 +103,37 @@ static void decode_and_execute(chip8_t *chip8) {
   instruction(chip8);
 }
 
-static void update_timers(chip8_t *chip8) {
+void tick_timers(chip8_t *chip8) {
   if (chip8->delay_timer > 0)
     chip8->delay_timer -= 1;
   if (chip8->sound_timer > 0)
     chip8->sound_timer -= 1;
 }
 
+/**
+ * @brief Pack the framebuffer to one bit per pixel, most significant bit
+ * first, PACKED_VIDEO_SIZE bytes in total.
+ */
+void pack_video(uint32_t const *video, uint8_t *packed) {
+  for (unsigned int i = 0; i < PACKED_VIDEO_SIZE; ++i) {
+    uint8_t byte = 0;
+    for (unsigned int bit = 0; bit < 8; ++bit)
+      byte = static_cast<uint8_t>((byte << 1u) | (video[i * 8 + bit] & 1u));
+    packed[i] = byte;
+  }
+}
+
+/**
+ * @brief Inverse of pack_video(): lit pixels become 0xFFFFFFFF, as Dxyn
+ * draws them.
+ */
+void unpack_video(uint8_t const *packed, uint32_t *video) {
+  for (unsigned int i = 0; i < PACKED_VIDEO_SIZE; ++i) {
+    for (unsigned int bit = 0; bit < 8; ++bit)
+      video[i * 8 + bit] = (packed[i] >> (7u - bit)) & 1u ? 0xFFFFFFFFu : 0;
+  }
+}
+
 static bytes_t read_program(const path_t &filepath) {
   std::ifstream file(filepath, std::ios::out | std::ios::binary);
   if (!file.is_open())
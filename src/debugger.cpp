@@ -0,0 +1,179 @@
+#include "debugger.h"
+#include "analyzer.h"
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+static std::string hex(unsigned int value, int digits) {
+  char buffer[16];
+  std::snprintf(buffer, sizeof(buffer), "%0*X", digits, value);
+  return buffer;
+}
+
+static uint16_t read_opcode(chip8_t const *chip8, uint16_t address) {
+  return static_cast<uint16_t>(
+      (chip8->memory[address % MEMORY_SIZE] << 8u) |
+      chip8->memory[(address + 1u) % MEMORY_SIZE]);
+}
+
+static uint16_t parse_address(std::string const &token) {
+  return static_cast<uint16_t>(std::stoul(token, nullptr, 0) % MEMORY_SIZE);
+}
+
+debugger_t::debugger_t(std::istream &in, std::ostream &out)
+    : in(in), out(out) {}
+
+debugger_t &debugger_t::add_breakpoint(uint16_t address) {
+  breakpoints.set(address % MEMORY_SIZE);
+  return *this;
+}
+
+debugger_t &debugger_t::remove_breakpoint(uint16_t address) {
+  breakpoints.reset(address % MEMORY_SIZE);
+  return *this;
+}
+
+debugger_t &debugger_t::add_watchpoint(uint16_t first, uint16_t last) {
+  for (unsigned int address = first; address <= last; ++address)
+    watchpoints.set(address % MEMORY_SIZE);
+  return *this;
+}
+
+debugger_t &debugger_t::remove_watchpoint(uint16_t first, uint16_t last) {
+  for (unsigned int address = first; address <= last; ++address)
+    watchpoints.reset(address % MEMORY_SIZE);
+  return *this;
+}
+
+bool debugger_t::run(chip8_t *chip8) {
+  if (!paused)
+    paused = hit(chip8);
+
+  if (paused && prompt(chip8))
+    return true;
+
+  run_cycle(chip8);
+
+  if (steps > 0 && --steps == 0)
+    paused = true;
+  return false;
+}
+
+bool debugger_t::hit(chip8_t const *chip8) {
+  if (chip8->pc < MEMORY_SIZE && breakpoints[chip8->pc]) {
+    out << "breakpoint 0x" << hex(chip8->pc, 3) << "\n";
+    return true;
+  }
+
+  auto opcode = read_opcode(chip8, chip8->pc);
+  auto op = decode(opcode);
+  if (op != op_t::op_Fx33 && op != op_t::op_Fx55)
+    return false;
+
+  auto length = op == op_t::op_Fx33 ? 3u : ((opcode & 0x0F00u) >> 8u) + 1u;
+  for (unsigned int i = 0; i < length; ++i) {
+    auto address = (chip8->index + i) % MEMORY_SIZE;
+    if (watchpoints[address]) {
+      out << "watchpoint 0x" << hex(address, 3) << " written by "
+          << disassemble(opcode) << "\n";
+      return true;
+    }
+  }
+  return false;
+}
+
+bool debugger_t::prompt(chip8_t *chip8) {
+  print_location(chip8);
+
+  std::string line;
+  while (out << "(chip8) " << std::flush, std::getline(in, line)) {
+    std::istringstream command(line);
+    std::string name, first, second;
+    command >> name >> first >> second;
+
+    try {
+      if (name == "s" || name == "step") {
+        steps = first.empty() ? 1 : std::stoul(first, nullptr, 0);
+        paused = false;
+        return false;
+      } else if (name == "c" || name == "continue") {
+        paused = false;
+        steps = 0;
+        return false;
+      } else if (name == "b" || name == "break") {
+        add_breakpoint(parse_address(first));
+      } else if (name == "d" || name == "delete") {
+        remove_breakpoint(parse_address(first));
+      } else if (name == "w" || name == "watch") {
+        auto begin = parse_address(first);
+        add_watchpoint(begin, second.empty() ? begin : parse_address(second));
+      } else if (name == "u" || name == "unwatch") {
+        auto begin = parse_address(first);
+        remove_watchpoint(begin,
+                          second.empty() ? begin : parse_address(second));
+      } else if (name == "r" || name == "registers") {
+        print_registers(chip8);
+      } else if (name == "k" || name == "stack") {
+        print_stack(chip8);
+      } else if (name == "m" || name == "memory") {
+        auto length = second.empty() ? 16 : std::stoul(second, nullptr, 0);
+        print_memory(chip8, parse_address(first),
+                     static_cast<uint16_t>(length));
+      } else if (name == "l" || name == "list") {
+        print_location(chip8);
+      } else if (name == "q" || name == "quit") {
+        return true;
+      } else {
+        out << "s [n]        step n instructions\n"
+            << "c            continue\n"
+            << "b/d ADDR     set/delete a breakpoint\n"
+            << "w/u FIRST [LAST]\n"
+            << "             set/remove a write watchpoint\n"
+            << "r            registers\n"
+            << "k            call stack\n"
+            << "m ADDR [LEN] dump memory\n"
+            << "l            show the next instruction\n"
+            << "q            quit\n";
+      }
+    } catch (std::logic_error const &) {
+      out << "invalid argument\n";
+    }
+  }
+
+  return true;
+}
+
+void debugger_t::print_location(chip8_t const *chip8) {
+  auto opcode = read_opcode(chip8, chip8->pc);
+  out << "0x" << hex(chip8->pc, 3) << "  " << hex(opcode, 4) << "  "
+      << disassemble(opcode) << "\n";
+}
+
+void debugger_t::print_registers(chip8_t const *chip8) {
+  for (unsigned int i = 0; i < REGISTER_COUNT; ++i)
+    out << "V" << hex(i, 1) << "=" << hex(chip8->registers[i], 2)
+        << ((i % 8 == 7) ? "\n" : " ");
+  out << "I=" << hex(chip8->index, 3) << " PC=" << hex(chip8->pc, 3)
+      << " SP=" << hex(chip8->sp, 2) << " DT=" << hex(chip8->delay_timer, 2)
+      << " ST=" << hex(chip8->sound_timer, 2) << "\n";
+}
+
+void debugger_t::print_stack(chip8_t const *chip8) {
+  if (chip8->sp == 0)
+    out << "empty\n";
+  auto depth = std::min<unsigned int>(chip8->sp, STACK_SIZE);
+  for (unsigned int i = depth; i > 0; --i)
+    out << "#" << depth - i << "  return to 0x"
+        << hex(chip8->stack[i - 1], 3) << "\n";
+}
+
+void debugger_t::print_memory(chip8_t const *chip8, uint16_t address,
+                              uint16_t length) {
+  for (unsigned int i = 0; i < length; ++i) {
+    auto current = (address + i) % MEMORY_SIZE;
+    if (i % 16 == 0)
+      out << (i ? "\n" : "") << "0x" << hex(current, 3) << ":";
+    out << " " << hex(chip8->memory[current], 2);
+  }
+  out << "\n";
+}
@@ -0,0 +1,192 @@
+#include "explorer.h"
+#include "memory.h"
+#include <algorithm>
+
+bool state_set_t::insert(uint64_t state, origin_t origin) {
+  auto &shard = shards[state % SHARD_COUNT];
+  std::lock_guard lock(shard.mutex);
+  if (!shard.states.emplace(state, origin).second)
+    return false;
+  count.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool state_set_t::find(uint64_t state, origin_t &origin) const {
+  auto const &shard = shards[state % SHARD_COUNT];
+  std::lock_guard lock(shard.mutex);
+  auto found = shard.states.find(state);
+  if (found == shard.states.end())
+    return false;
+  origin = found->second;
+  return true;
+}
+
+explorer_t::explorer_t(chip8_t const &boot, unsigned int threads)
+    : boot(boot), pool(threads) {
+  actions.push_back(0);
+  for (unsigned int key = 0; key < KEY_COUNT; ++key)
+    actions.push_back(static_cast<uint16_t>(1u << key));
+}
+
+explorer_t &explorer_t::set_actions(std::vector<uint16_t> actions) {
+  this->actions = std::move(actions);
+  return *this;
+}
+
+explorer_t &explorer_t::set_frames_per_step(unsigned int frames) {
+  frames_per_step = std::max(frames, 1u);
+  return *this;
+}
+
+explorer_t &explorer_t::set_max_depth(unsigned int depth) {
+  max_depth = depth;
+  return *this;
+}
+
+explorer_t &explorer_t::set_max_states(size_t states) {
+  max_states = states;
+  return *this;
+}
+
+std::vector<uint16_t> explorer_t::inputs_to(uint64_t state) const {
+  std::vector<uint16_t> inputs;
+  state_set_t::origin_t origin;
+  while (visited.find(state, origin) && origin.parent != state) {
+    inputs.push_back(actions[origin.action]);
+    state = origin.parent;
+  }
+  std::reverse(inputs.begin(), inputs.end());
+  return inputs;
+}
+
+explorer_t::node_t explorer_t::save(chip8_t const *chip8,
+                                    state_hash_t const &hash,
+                                    std::shared_ptr<memory_t const> memory) {
+  node_t node;
+  if (!memory) {
+    auto copy = std::make_shared<memory_t>();
+    std::memcpy(copy->data(), chip8->memory, copy->size());
+    memory = std::move(copy);
+  }
+  node.memory = std::move(memory);
+  pack_video(chip8->video, node.video);
+  std::memcpy(node.core, reinterpret_cast<uint8_t const *>(chip8) + CORE_OFFSET,
+              sizeof(node.core));
+  node.hash = hash;
+  return node;
+}
+
+void explorer_t::restore(node_t const &node, chip8_t *chip8) {
+  std::memcpy(chip8->memory, node.memory->data(), node.memory->size());
+  unpack_video(node.video, chip8->video);
+  std::memcpy(reinterpret_cast<uint8_t *>(chip8) + CORE_OFFSET, node.core,
+              sizeof(node.core));
+}
+
+explorer_report_t explorer_t::run() {
+  explorer_report_t report;
+  std::mutex mutex;
+
+  std::vector<node_t> frontier;
+  frontier.push_back(save(&boot, hash_state(&boot), nullptr));
+  auto root = frontier[0].hash.value();
+  visited.insert(root, {root, 0});
+
+  // Findings keep the parent and action; inputs are rebuilt at the end.
+  struct pending_t {
+    uint64_t parent;
+    int action; // -1 for a soft-lock of the parent itself
+    uint16_t pc;
+    std::string what;
+  };
+  std::vector<pending_t> crashes, soft_locks;
+
+  while (!frontier.empty() && report.depth < max_depth &&
+         visited.size() < max_states) {
+    std::vector<node_t> next;
+
+    pool.parallel_for(frontier.size(), [&](size_t i) {
+      auto const &parent = frontier[i];
+      auto parent_state = parent.hash.value();
+      auto parent_machine = std::make_unique<chip8_t>(boot);
+      restore(parent, parent_machine.get());
+      auto child_machine = std::make_unique<chip8_t>();
+
+      std::bitset<MEMORY_SIZE> pcs;
+      std::vector<node_t> children;
+      std::vector<pending_t> faults;
+      bool stuck = true;
+
+      for (size_t action = 0; action < actions.size(); ++action) {
+        if (visited.size() >= max_states) {
+          stuck = false;
+          break;
+        }
+
+        auto *chip8 = child_machine.get();
+        *chip8 = *parent_machine;
+        state_dirty_t dirty;
+
+        try {
+          for (unsigned int frame = 0; frame < frames_per_step; ++frame) {
+            for (unsigned int key = 0; key < KEY_COUNT; ++key)
+              chip8->keypad[key] =
+                  static_cast<uint8_t>((actions[action] >> key) & 1u);
+            for (unsigned int cycle = 0; cycle < CYCLES_PER_FRAME; ++cycle) {
+              pcs.set(chip8->pc & MEMORY_MASK);
+              run_cycle_checked(chip8);
+              note_writes(chip8, dirty);
+            }
+          }
+        } catch (memory_fault_t const &fault) {
+          faults.push_back({parent_state, static_cast<int>(action), fault.pc,
+                            fault.what()});
+          stuck = false;
+          continue;
+        }
+
+        auto hash = rehash_state(chip8, parent.hash, dirty);
+        if (hash == parent.hash)
+          continue;
+        stuck = false;
+
+        auto state = hash.value();
+        if (visited.insert(state, {parent_state,
+                                   static_cast<uint16_t>(action)}))
+          children.push_back(
+              save(chip8, hash, dirty.memory ? nullptr : parent.memory));
+      }
+
+      std::lock_guard lock(mutex);
+      report.pcs |= pcs;
+      crashes.insert(crashes.end(), faults.begin(), faults.end());
+      if (stuck)
+        soft_locks.push_back({parent_state, -1, parent_machine->pc,
+                              "no input changes the state"});
+      next.insert(next.end(), std::make_move_iterator(children.begin()),
+                  std::make_move_iterator(children.end()));
+    });
+
+    frontier = std::move(next);
+    report.depth += 1;
+  }
+
+  report.states = visited.size();
+  report.exhausted = frontier.empty();
+
+  auto resolve = [&](pending_t const &pending) {
+    explorer_finding_t finding;
+    finding.state = pending.parent;
+    finding.inputs = inputs_to(pending.parent);
+    if (pending.action >= 0)
+      finding.inputs.push_back(actions[static_cast<size_t>(pending.action)]);
+    finding.pc = pending.pc;
+    finding.what = pending.what;
+    return finding;
+  };
+  for (auto const &crash : crashes)
+    report.crashes.push_back(resolve(crash));
+  for (auto const &soft_lock : soft_locks)
+    report.soft_locks.push_back(resolve(soft_lock));
+  return report;
+}
@@ -0,0 +1,193 @@
+#include "fusion.h"
+#include <algorithm>
+
+static uint8_t make_vx(uint16_t opcode) { return ((opcode & 0x0F00u) >> 8u); }
+
+static uint8_t make_kk(uint16_t opcode) { return (opcode & 0x00FFu); }
+
+static uint16_t make_nnn(uint16_t opcode) { return (opcode & 0x0FFFu); }
+
+/**
+ * @brief tick_timers() n times. Only valid where none of the instructions in
+ * between read the timers.
+ */
+static void tick_timers(chip8_t *chip8, unsigned int n) {
+  chip8->delay_timer = static_cast<uint8_t>(
+      chip8->delay_timer > n ? chip8->delay_timer - n : 0);
+  chip8->sound_timer = static_cast<uint8_t>(
+      chip8->sound_timer > n ? chip8->sound_timer - n : 0);
+}
+
+// In every fused handler entry[2 * i] is instruction i of the group, and pc
+// is the address of the group, already wrapped.
+
+/**
+ * @brief Annn, Dxyn.
+ */
+static unsigned int run_sprite(chip8_t *chip8,
+                               fused_program_t::entry_t const *entry,
+                               [[maybe_unused]] unsigned int budget) {
+  chip8->index = make_nnn(entry[0].opcode);
+  chip8->opcode = entry[2].opcode;
+  chip8->pc += 4;
+  entry[2].handler(chip8);
+  tick_timers(chip8, 2);
+  return 2;
+}
+
+/**
+ * @brief A run of 6xkk.
+ */
+static unsigned int run_loads(chip8_t *chip8,
+                              fused_program_t::entry_t const *entry,
+                              [[maybe_unused]] unsigned int budget) {
+  unsigned int length = entry->length;
+  for (unsigned int i = 0; i < length; ++i) {
+    auto opcode = entry[2 * i].opcode;
+    chip8->registers[make_vx(opcode)] = make_kk(opcode);
+  }
+  chip8->opcode = entry[2 * (length - 1)].opcode;
+  chip8->pc += static_cast<uint16_t>(2 * length);
+  tick_timers(chip8, length);
+  return length;
+}
+
+/**
+ * @brief 7xkk, 3ykk, 1nnn: add, leave the loop when Vy = kk, jump back.
+ */
+static unsigned int run_counted_loop(chip8_t *chip8,
+                                     fused_program_t::entry_t const *entry,
+                                     unsigned int budget) {
+  auto add = entry[0].opcode, test = entry[2].opcode, jump = entry[4].opcode;
+  auto &counter = chip8->registers[make_vx(add)];
+  auto const &tested = chip8->registers[make_vx(test)];
+  auto start = chip8->pc;
+
+  unsigned int executed = 0;
+  do {
+    counter = static_cast<uint8_t>(counter + make_kk(add));
+    if (tested == make_kk(test)) {
+      chip8->opcode = test;
+      chip8->pc = static_cast<uint16_t>(start + 6);
+      tick_timers(chip8, 2);
+      return executed + 2;
+    }
+    chip8->pc = make_nnn(jump);
+    tick_timers(chip8, 3);
+    executed += 3;
+  } while (chip8->pc == start && budget - executed >= 3);
+
+  chip8->opcode = jump;
+  return executed;
+}
+
+/**
+ * @brief Fx07, 3xkk, 1nnn: copy the delay timer, leave the loop when it
+ * reads kk, jump back.
+ */
+static unsigned int run_timer_wait(chip8_t *chip8,
+                                   fused_program_t::entry_t const *entry,
+                                   unsigned int budget) {
+  auto load = entry[0].opcode, test = entry[2].opcode, jump = entry[4].opcode;
+  auto &value = chip8->registers[make_vx(load)];
+  auto start = chip8->pc;
+
+  unsigned int executed = 0;
+  do {
+    value = chip8->delay_timer;
+    if (value == make_kk(test)) {
+      chip8->opcode = test;
+      chip8->pc = static_cast<uint16_t>(start + 6);
+      tick_timers(chip8, 2);
+      return executed + 2;
+    }
+    chip8->pc = make_nnn(jump);
+    tick_timers(chip8, 3);
+    executed += 3;
+  } while (chip8->pc == start && budget - executed >= 3);
+
+  chip8->opcode = jump;
+  return executed;
+}
+
+static uint16_t read_opcode(chip8_t const *chip8, unsigned int address) {
+  // The memory mirror covers the second byte at the last address.
+  return static_cast<uint16_t>((chip8->memory[address] << 8u) |
+                               chip8->memory[address + 1]);
+}
+
+void fused_program_t::predecode(chip8_t const *chip8) {
+  for (unsigned int address = 0; address < MEMORY_SIZE; ++address)
+    predecode(chip8, address);
+}
+
+void fused_program_t::predecode(chip8_t const *chip8, unsigned int address) {
+  auto &entry = entries[address];
+  entry.opcode = read_opcode(chip8, address);
+  entry.handler = lookup_handler(entry.opcode);
+  entry.fused = nullptr;
+  entry.length = 1;
+  entry.stores = (entry.opcode & 0xF0FFu) == 0xF033u ||
+                 (entry.opcode & 0xF0FFu) == 0xF055u;
+
+  // Groups never wrap around the end of memory, unlike pc.
+  auto available = std::min((MEMORY_SIZE - address) / 2,
+                            MAX_FUSED_INSTRUCTIONS);
+  auto at = [&](unsigned int i) {
+    return read_opcode(chip8, address + 2 * i);
+  };
+
+  auto first = entry.opcode;
+  if (available >= 2 && (first & 0xF000u) == 0xA000u &&
+      (at(1) & 0xF000u) == 0xD000u) {
+    entry.fused = run_sprite;
+    entry.length = 2;
+  } else if ((first & 0xF000u) == 0x6000u) {
+    unsigned int length = 1;
+    while (length < available && (at(length) & 0xF000u) == 0x6000u)
+      length += 1;
+    if (length >= 2) {
+      entry.fused = run_loads;
+      entry.length = static_cast<uint8_t>(length);
+    }
+  } else if (available >= 3 && (at(1) & 0xF000u) == 0x3000u &&
+             (at(2) & 0xF000u) == 0x1000u) {
+    if ((first & 0xF000u) == 0x7000u) {
+      entry.fused = run_counted_loop;
+      entry.length = 3;
+    } else if ((first & 0xF0FFu) == 0xF007u &&
+               make_vx(first) == make_vx(at(1))) {
+      entry.fused = run_timer_wait;
+      entry.length = 3;
+    }
+  }
+}
+
+unsigned int fused_program_t::step(chip8_t *chip8, unsigned int budget) {
+  chip8->pc &= MEMORY_MASK;
+  auto const *entry = &entries[chip8->pc];
+  if (entry->fused && entry->length <= budget)
+    return entry->fused(chip8, entry, budget);
+
+  chip8->opcode = entry->opcode;
+  chip8->pc += 2;
+  entry->handler(chip8);
+  tick_timers(chip8);
+  if (entry->stores) {
+    // Refresh every entry that reads the stored bytes, including groups
+    // that start before them and, through the mirror, the last address.
+    auto opcode = entry->opcode;
+    unsigned int length =
+        (opcode & 0x00FFu) == 0x33u ? 3 : make_vx(opcode) + 1u;
+    unsigned int first = chip8->index + MEMORY_SIZE -
+                         (2 * MAX_FUSED_INSTRUCTIONS - 1);
+    for (unsigned int i = 0; i < length + 2 * MAX_FUSED_INSTRUCTIONS - 1; ++i)
+      predecode(chip8, (first + i) & MEMORY_MASK);
+  }
+  return 1;
+}
+
+void fused_program_t::run(chip8_t *chip8, unsigned int count) {
+  while (count > 0)
+    count -= step(chip8, count);
+}
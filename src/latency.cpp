@@ -0,0 +1,50 @@
+#include "latency.h"
+#include <algorithm>
+
+static double percentile(std::vector<double> samples, double fraction) {
+  if (samples.empty())
+    return 0;
+
+  auto rank = static_cast<size_t>(fraction *
+                                  static_cast<double>(samples.size() - 1));
+  std::nth_element(samples.begin(),
+                   samples.begin() + static_cast<std::ptrdiff_t>(rank),
+                   samples.end());
+  return samples[rank];
+}
+
+latency_tracer_t::latency_tracer_t(uint64_t frequency)
+    : frequency(std::max<uint64_t>(frequency, 1)) {}
+
+void latency_tracer_t::key_written(uint64_t counter, uint32_t queued_ms) {
+  pending.emplace_back(counter, queued_ms);
+}
+
+void latency_tracer_t::presented(uint64_t counter) {
+  for (auto [written, queued] : pending) {
+    auto elapsed = static_cast<double>(counter - written) * 1000.0 /
+                   static_cast<double>(frequency);
+    total_ms.push_back(queued + elapsed);
+    queued_ms.push_back(queued);
+  }
+  pending.clear();
+}
+
+latency_report_t latency_tracer_t::report() const {
+  latency_report_t report;
+  report.samples = total_ms.size();
+  report.p50_ms = percentile(total_ms, 0.5);
+  report.p99_ms = percentile(total_ms, 0.99);
+  report.max_ms = percentile(total_ms, 1.0);
+  report.queued_p50_ms = percentile(queued_ms, 0.5);
+  report.queued_p99_ms = percentile(queued_ms, 0.99);
+  return report;
+}
+
+void latency_tracer_t::write_report(std::ostream &out) const {
+  auto stats = report();
+  out << "latency: " << stats.samples << " key events, p50 " << stats.p50_ms
+      << " ms, p99 " << stats.p99_ms << " ms, max " << stats.max_ms
+      << " ms (queued p50 " << stats.queued_p50_ms << " ms, p99 "
+      << stats.queued_p99_ms << " ms)\n";
+}
@@ -0,0 +1,80 @@
+#include "machine_pool.h"
+#include "state.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <system_error>
+
+const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+machine_pool_t::machine_pool_t(chip8_t const &image, size_t capacity)
+    : image(image), count(capacity), base_seed(image.random_state),
+      episodes(capacity), released(capacity) {
+  arena_size = std::max<size_t>(capacity * STRIDE, 1);
+  arena_size = (arena_size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE *
+               HUGE_PAGE_SIZE;
+
+  auto address = mmap(nullptr, arena_size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  hugetlb = address != MAP_FAILED;
+  if (!hugetlb) {
+    address = mmap(nullptr, arena_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (address == MAP_FAILED)
+      throw std::system_error(errno, std::generic_category(), "mmap");
+    // Only a hint: without transparent huge pages this is a no-op.
+    madvise(address, arena_size, MADV_HUGEPAGE);
+  }
+  arena = static_cast<uint8_t *>(address);
+  free_list.reserve(capacity);
+}
+
+machine_pool_t::~machine_pool_t() { munmap(arena, arena_size); }
+
+chip8_t *machine_pool_t::acquire() {
+  if (!free_list.empty()) {
+    auto *chip8 = free_list.back();
+    free_list.pop_back();
+    released[slot(chip8)] = false;
+    reset(chip8);
+    return chip8;
+  }
+  if (constructed == count)
+    return nullptr;
+  auto *chip8 = new (arena + STRIDE * constructed++) chip8_t(image);
+  reseed(chip8);
+  return chip8;
+}
+
+void machine_pool_t::release(chip8_t *chip8) {
+  // Compared as integers: the pointer may belong to another allocation.
+  auto address = reinterpret_cast<uintptr_t>(chip8);
+  auto start = reinterpret_cast<uintptr_t>(arena);
+  if (address < start || address >= start + constructed * STRIDE ||
+      (address - start) % STRIDE != 0)
+    throw std::invalid_argument("Machine does not belong to this pool.");
+  if (released[slot(chip8)])
+    throw std::invalid_argument("Machine released twice.");
+
+  released[slot(chip8)] = true;
+  free_list.push_back(chip8);
+}
+
+void machine_pool_t::reset(chip8_t *chip8) {
+  std::memcpy(static_cast<void *>(chip8), &image, sizeof(chip8_t));
+  reseed(chip8);
+}
+
+machine_pool_t &machine_pool_t::set_seed(uint32_t seed) {
+  base_seed = seed;
+  return *this;
+}
+
+void machine_pool_t::reseed(chip8_t *chip8) {
+  auto index = slot(chip8);
+  uint64_t key[] = {base_seed, index, episodes[index]++};
+  seed_random(chip8, static_cast<uint32_t>(hash_bytes(key, sizeof(key))));
+}
@@ -1,38 +1,417 @@
+#include "analyzer.h"
+#include "aot.h"
+#include "audio.h"
 #include "chip8.h"
+#include "debugger.h"
+#include "fusion.h"
+#include "memory.h"
+#include "netplay.h"
+#include "profiler.h"
+#include "recorder.h"
+#include "shared_frame.h"
+#include "trace.h"
+#include "vip_timing.h"
 #include "viewer.h"
+#include <chrono>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
-int main(int argc, char *argv[]) {
-  if (argc != 3) {
-    std::cerr << "Usage: " << argv[0] << " <Scale> <ROM>\n";
-    std::exit(EXIT_FAILURE);
+struct options_t {
+  int window_scale{};
+  char const *rom_filename{};
+
+  bool audio = true;
+  uint16_t audio_device_samples = 256;
+  size_t audio_queue_samples = 512;
+
+  char const *aot_module{};
+  bool fusion{};
+  bool debug{};
+  bool checked{};
+  bool vip_timing{};
+  char const *shared_frame{};
+  char const *record{};
+  bool latency{};
+  char const *trace{};
+
+  uint16_t netplay_port{};
+  std::string netplay_peer;
+  unsigned int netplay_latency_ms{};
+  double netplay_loss{};
+
+  char const *profile{};
+  unsigned int profile_interval = 97;
+  char const *symbols{};
+};
+
+static void usage(char const *program) {
+  std::cerr << "Usage: " << program << " <Scale> <ROM> [options]\n"
+            << "Options:\n"
+            << "  --no-audio                 disable sound output\n"
+            << "  --audio-device-samples N   SDL audio buffer size\n"
+            << "  --audio-queue-samples N    samples queued ahead of the "
+               "audio device\n"
+            << "  --aot MODULE               run recompiled blocks from a "
+               "chip8_aot module\n"
+            << "  --fusion                   run common instruction idioms "
+               "as fused handlers\n"
+            << "  --debug                    start in the interactive "
+               "debugger\n"
+            << "  --vip-timing               run at COSMAC VIP speed, "
+               "cycle by cycle\n"
+            << "  --checked                  stop on stack, pc, I and memory "
+               "faults\n"
+            << "  --shm NAME                 publish frames and accept keys "
+               "through shared memory\n"
+            << "  --record FILE              write every frame to a "
+               "recording\n"
+            << "  --latency                  report input-to-present "
+               "latency on exit\n"
+            << "  --trace FILE               write a binary instruction "
+               "trace, see chip8_trace\n"
+            << "  --netplay PORT HOST:PORT   two-player rollback netplay "
+               "from local UDP PORT\n"
+            << "  --netplay-latency MS       simulated one-way latency\n"
+            << "  --netplay-loss P           simulated packet loss, 0.05 = "
+               "5%\n"
+            << "  --profile FILE             write guest call-stack samples "
+               "for flamegraphs\n"
+            << "  --profile-interval N       instructions between samples\n"
+            << "  --symbols FILE             \"<address> <name>\" lines "
+               "naming subroutines\n"
+            << "At most one of --aot, --fusion, --debug, --vip-timing, "
+               "--checked, --trace,\n--netplay and --profile may be given.\n";
+  std::exit(EXIT_FAILURE);
+}
+
+static options_t parse_options(int argc, char *argv[]) {
+  if (argc < 3)
+    usage(argv[0]);
+
+  options_t options;
+  options.window_scale = std::stoi(argv[1]);
+  options.rom_filename = argv[2];
+
+  for (int i = 3; i < argc; ++i) {
+    auto has_value = i + 1 < argc;
+    if (std::strcmp(argv[i], "--no-audio") == 0) {
+      options.audio = false;
+    } else if (std::strcmp(argv[i], "--audio-device-samples") == 0 &&
+               has_value) {
+      auto samples = std::stoul(argv[++i]);
+      if (samples == 0 || samples > UINT16_MAX) {
+        std::cerr << "--audio-device-samples must be 1 to " << UINT16_MAX
+                  << "\n";
+        usage(argv[0]);
+      }
+      options.audio_device_samples = static_cast<uint16_t>(samples);
+    } else if (std::strcmp(argv[i], "--audio-queue-samples") == 0 &&
+               has_value) {
+      options.audio_queue_samples = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--aot") == 0 && has_value) {
+      options.aot_module = argv[++i];
+    } else if (std::strcmp(argv[i], "--fusion") == 0) {
+      options.fusion = true;
+    } else if (std::strcmp(argv[i], "--debug") == 0) {
+      options.debug = true;
+    } else if (std::strcmp(argv[i], "--vip-timing") == 0) {
+      options.vip_timing = true;
+    } else if (std::strcmp(argv[i], "--checked") == 0) {
+      options.checked = true;
+    } else if (std::strcmp(argv[i], "--shm") == 0 && has_value) {
+      options.shared_frame = argv[++i];
+    } else if (std::strcmp(argv[i], "--record") == 0 && has_value) {
+      options.record = argv[++i];
+    } else if (std::strcmp(argv[i], "--latency") == 0) {
+      options.latency = true;
+    } else if (std::strcmp(argv[i], "--trace") == 0 && has_value) {
+      options.trace = argv[++i];
+    } else if (std::strcmp(argv[i], "--netplay") == 0 && i + 2 < argc) {
+      options.netplay_port = static_cast<uint16_t>(std::stoul(argv[++i]));
+      options.netplay_peer = argv[++i];
+    } else if (std::strcmp(argv[i], "--netplay-latency") == 0 && has_value) {
+      options.netplay_latency_ms =
+          static_cast<unsigned int>(std::stoul(argv[++i]));
+    } else if (std::strcmp(argv[i], "--netplay-loss") == 0 && has_value) {
+      options.netplay_loss = std::stod(argv[++i]);
+    } else if (std::strcmp(argv[i], "--profile") == 0 && has_value) {
+      options.profile = argv[++i];
+    } else if (std::strcmp(argv[i], "--profile-interval") == 0 && has_value) {
+      options.profile_interval =
+          static_cast<unsigned int>(std::stoul(argv[++i]));
+    } else if (std::strcmp(argv[i], "--symbols") == 0 && has_value) {
+      options.symbols = argv[++i];
+    } else {
+      usage(argv[0]);
+    }
+  }
+
+  // Each execution mode has its own loop, so a second one would be ignored.
+  std::vector<char const *> modes;
+  for (auto [set, flag] : {std::pair{options.debug, "--debug"},
+                           {options.profile != nullptr, "--profile"},
+                           {options.aot_module != nullptr, "--aot"},
+                           {options.fusion, "--fusion"},
+                           {options.trace != nullptr, "--trace"},
+                           {options.netplay_port != 0, "--netplay"},
+                           {options.vip_timing, "--vip-timing"},
+                           {options.checked, "--checked"}}) {
+    if (set)
+      modes.push_back(flag);
+  }
+  if (modes.size() > 1) {
+    std::cerr << modes[0] << " cannot be combined with " << modes[1] << "\n";
+    usage(argv[0]);
+  }
+  if (options.symbols && !options.profile) {
+    std::cerr << "--symbols needs --profile\n";
+    usage(argv[0]);
+  }
+  if ((options.netplay_latency_ms != 0 || options.netplay_loss > 0) &&
+      options.netplay_port == 0) {
+    std::cerr << "--netplay-latency and --netplay-loss need --netplay\n";
+    usage(argv[0]);
+  }
+
+  return options;
+}
+
+/**
+ * @brief Everything a frame is presented to besides the machine itself.
+ */
+struct frontend_t {
+  viewer_t &viewer;
+  audio_t &audio;
+  shared_frame_writer_t *shared;
+  recorder_t *recorder;
+};
+
+/**
+ * @brief What one step of an execution engine did.
+ */
+struct step_result_t {
+  bool quit{};
+  // Instructions executed. The loop waits its delay once per instruction, so
+  // engines that run several at a time keep the speed of the interpreter;
+  // engines that pace themselves against the clock report none.
+  unsigned int instructions = 1;
+};
+
+/**
+ * @brief Frontend loop. It is instantiated once per execution engine, so
+ * modes such as the debugger add no checks to the default path. step() runs
+ * the machine and returns a step_result_t.
+ */
+template <typename Step>
+static void run_loop(frontend_t &frontend, chip8_t *chip8, Step step) {
+  auto &[viewer, audio, shared, recorder] = frontend;
+  int video_pitch = sizeof(chip8->video[0]) * VIDEO_WIDTH;
+  bool quit = false;
+
+  // Readers of the shared segment and recordings see at most one frame per
+  // 60 Hz tick, whatever the engine's step rate.
+  auto frame_period = std::chrono::microseconds(1000000 / 60);
+  auto next_frame = std::chrono::steady_clock::now();
+
+  uint32_t speed = 3;
+  while (!quit) {
+    quit = viewer.process_input(chip8->keypad);
+    if (shared)
+      shared->apply_input(chip8);
+    step_result_t result{.quit = quit, .instructions = 0};
+    if (!quit)
+      result = step(chip8);
+    quit = result.quit;
+    if (shared || recorder) {
+      auto now = std::chrono::steady_clock::now();
+      if (now >= next_frame) {
+        if (shared)
+          shared->publish(chip8);
+        if (recorder)
+          recorder->capture(chip8);
+        next_frame += frame_period;
+        if (next_frame <= now)
+          next_frame = now + frame_period;
+      }
+    }
+    audio.update(chip8);
+    viewer.update(chip8->video, video_pitch);
+    if (result.instructions > 0)
+      viewer.delay(speed * result.instructions);
   }
+}
 
-  int window_scale = std::stoi(argv[1]);
-  char const *romFilename = argv[3];
+int main(int argc, char *argv[]) {
+  auto options = parse_options(argc, argv);
 
   viewer_t viewer;
   viewer.set_window_title("CHIP-8 Emulator")
-      .set_window_scale(window_scale)
+      .set_window_scale(options.window_scale)
       .set_window_width(VIDEO_WIDTH)
       .set_window_height(VIDEO_HEIGHT)
       .set_texture_width(VIDEO_WIDTH)
       .set_texture_height(VIDEO_HEIGHT)
       .build();
 
+  latency_tracer_t latency(SDL_GetPerformanceFrequency());
+  if (options.latency)
+    viewer.set_latency_tracer(&latency);
+
+  audio_t audio;
+  if (options.audio) {
+    try {
+      audio.set_device_samples(options.audio_device_samples)
+          .set_queue_samples(options.audio_queue_samples)
+          // --vip-timing and --netplay feed the device once per 60 Hz frame.
+          .set_update_rate(options.vip_timing || options.netplay_port ? 60 : 0)
+          .build();
+    } catch (std::runtime_error const &error) {
+      std::cerr << "audio: " << error.what() << ", continuing without sound\n";
+      options.audio = false;
+    }
+  }
+
   auto chip8 = make_chip8();
-  load_rom(chip8.get(), romFilename);
+  load_rom(chip8.get(), options.rom_filename);
 
-  int video_pitch = sizeof(chip8->video[0]) * VIDEO_WIDTH;
-  bool quit = false;
+  std::unique_ptr<shared_frame_writer_t> shared;
+  if (options.shared_frame)
+    shared = std::make_unique<shared_frame_writer_t>(options.shared_frame);
 
-  uint32_t speed = 3;
-  while (!quit) {
-    quit = viewer.process_input(chip8->keypad);
-    run_cycle(chip8.get());
-    viewer.update(chip8->video, video_pitch);
-    viewer.delay(speed);
+  std::unique_ptr<recorder_t> recorder;
+  if (options.record)
+    recorder = std::make_unique<recorder_t>(options.record);
+
+  frontend_t frontend{viewer, audio, shared.get(), recorder.get()};
+
+  if (options.debug) {
+    debugger_t debugger(std::cin, std::cout);
+    run_loop(frontend, chip8.get(), [&](chip8_t *chip8) {
+      return step_result_t{.quit = debugger.run(chip8)};
+    });
+  } else if (options.profile) {
+    auto rom_size = std::filesystem::file_size(options.rom_filename);
+    auto rom_end = static_cast<uint16_t>(PROGRAM_START_ADDRESS + rom_size);
+
+    profiler_t profiler(options.profile_interval);
+    profiler.add_symbols(analyze(chip8->memory, rom_end));
+    if (options.symbols)
+      profiler.load_symbols(options.symbols);
+
+    run_loop(frontend, chip8.get(), [&](chip8_t *chip8) {
+      profiler.run(chip8);
+      return step_result_t{};
+    });
+
+    std::ofstream out(options.profile);
+    profiler.write_collapsed(out);
+  } else if (options.aot_module) {
+    aot_module_t aot;
+    aot.load(options.aot_module, chip8.get());
+    run_loop(frontend, chip8.get(), [&](chip8_t *chip8) {
+      return step_result_t{.instructions = aot.run(chip8)};
+    });
+  } else if (options.fusion) {
+    fused_program_t program;
+    program.predecode(chip8.get());
+    run_loop(frontend, chip8.get(), [&](chip8_t *chip8) {
+      return step_result_t{.instructions =
+                               program.step(chip8, CYCLES_PER_FRAME)};
+    });
+  } else if (options.trace) {
+    tracer_t tracer(options.trace);
+    auto &stream = tracer.open_stream();
+    run_loop(frontend, chip8.get(), [&](chip8_t *chip8) {
+      auto pc = static_cast<uint16_t>(chip8->pc & MEMORY_MASK);
+      run_cycle(chip8);
+      stream.record(chip8, pc);
+      return step_result_t{};
+    });
+    stream.flush();
+  } else if (options.netplay_port) {
+    auto colon = options.netplay_peer.rfind(':');
+    if (colon == std::string::npos)
+      usage(argv[0]);
+    udp_link_t link(options.netplay_port, options.netplay_peer.substr(0, colon),
+                    static_cast<uint16_t>(
+                        std::stoul(options.netplay_peer.substr(colon + 1))));
+    link.set_latency(std::chrono::milliseconds(options.netplay_latency_ms))
+        .set_loss(options.netplay_loss);
+
+    // Both peers must boot the same machine.
+    seed_random(chip8.get(), NETPLAY_SEED);
+    netplay_t netplay(link);
+    auto frame_period = std::chrono::microseconds(1000000 / 60);
+    auto deadline = std::chrono::steady_clock::now();
+    run_loop(frontend, chip8.get(), [&](chip8_t *chip8) {
+      uint16_t keys = 0;
+      for (unsigned int key = 0; key < KEY_COUNT; ++key)
+        keys = static_cast<uint16_t>(keys | (chip8->keypad[key] & 1u) << key);
+      netplay.advance(chip8, keys);
+      deadline += frame_period;
+      // After a stall, start again from now rather than racing to catch up.
+      auto now = std::chrono::steady_clock::now();
+      if (deadline <= now)
+        deadline = now + frame_period;
+      std::this_thread::sleep_until(deadline);
+      return step_result_t{.instructions = 0};
+    });
+
+    auto const &stats = netplay.stats();
+    std::cerr << "netplay: " << stats.frames << " frames, " << stats.stalls
+              << " stalls, " << stats.rollbacks << " rollbacks (max "
+              << stats.max_rollback << " frames, " << stats.max_rollback_ms
+              << " ms), " << stats.desyncs << " desyncs\n";
+  } else if (options.vip_timing) {
+    // One 60 Hz frame per iteration, paced against the wall clock.
+    vip_clock_t clock;
+    auto frame_period = std::chrono::microseconds(1000000 / 60);
+    auto deadline = std::chrono::steady_clock::now();
+    run_loop(frontend, chip8.get(), [&](chip8_t *chip8) {
+      clock.run_frame(chip8);
+      deadline += frame_period;
+      // After a stall, start again from now rather than racing to catch up.
+      auto now = std::chrono::steady_clock::now();
+      if (deadline <= now)
+        deadline = now + frame_period;
+      std::this_thread::sleep_until(deadline);
+      return step_result_t{.instructions = 0};
+    });
+  } else if (options.checked) {
+    run_loop(frontend, chip8.get(), [](chip8_t *chip8) -> step_result_t {
+      try {
+        run_cycle_checked(chip8);
+      } catch (memory_fault_t const &fault) {
+        std::cerr << fault.what() << "\n";
+        return {.quit = true};
+      }
+      return {};
+    });
+  } else {
+    run_loop(frontend, chip8.get(), [](chip8_t *chip8) {
+      run_cycle(chip8);
+      return step_result_t{};
+    });
+  }
+
+  if (options.latency)
+    latency.write_report(std::cerr);
+
+  if (recorder && recorder->dropped_frames() > 0)
+    std::cerr << "record: " << recorder->dropped_frames()
+              << " frames dropped\n";
+
+  if (options.audio) {
+    auto stats = audio.stats();
+    std::cerr << "audio: " << stats.underruns << " underruns ("
+              << stats.underrun_samples << " samples), latency "
+              << stats.latency_ms << " ms\n";
   }
 
   return 0;
-}
\ No newline at end of file
+}
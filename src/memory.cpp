@@ -0,0 +1,73 @@
+#include "memory.h"
+#include "analyzer.h"
+#include <cstdio>
+
+static std::string describe(std::string const &what, chip8_t const *chip8,
+                            uint16_t opcode) {
+  char buffer[96];
+  std::snprintf(buffer, sizeof(buffer),
+                " at pc=0x%03X (%04X %s), I=0x%03X, sp=%u", chip8->pc, opcode,
+                disassemble(opcode).c_str(), chip8->index, chip8->sp);
+  return what + buffer;
+}
+
+memory_fault_t::memory_fault_t(std::string const &what, chip8_t const *chip8,
+                               uint16_t opcode)
+    : std::runtime_error(describe(what, chip8, opcode)), pc(chip8->pc),
+      opcode(opcode), index(chip8->index), sp(chip8->sp) {}
+
+static void check_range(chip8_t const *chip8, uint16_t opcode,
+                        unsigned int length) {
+  if (chip8->index + length > MEMORY_SIZE)
+    throw memory_fault_t("memory access out of range", chip8, opcode);
+}
+
+void run_cycle_checked(chip8_t *chip8) {
+  if (chip8->pc > MEMORY_SIZE - 2)
+    throw memory_fault_t("pc out of range", chip8, 0);
+
+  auto opcode = static_cast<uint16_t>((chip8->memory[chip8->pc] << 8u) |
+                                      chip8->memory[chip8->pc + 1]);
+  auto vx = (opcode & 0x0F00u) >> 8u;
+
+  switch (decode(opcode)) {
+  case op_t::op_00EE:
+    if (chip8->sp == 0)
+      throw memory_fault_t("stack underflow", chip8, opcode);
+    break;
+  case op_t::op_2nnn:
+    if (chip8->sp >= STACK_SIZE)
+      throw memory_fault_t("stack overflow", chip8, opcode);
+    break;
+  case op_t::op_Bnnn:
+    if (chip8->registers[0] + (opcode & 0x0FFFu) > MEMORY_SIZE - 2)
+      throw memory_fault_t("jump out of range", chip8, opcode);
+    break;
+  case op_t::op_Dxyn:
+    check_range(chip8, opcode, opcode & 0x000Fu);
+    break;
+  case op_t::op_Ex9E:
+  case op_t::op_ExA1:
+    if (chip8->registers[vx] >= KEY_COUNT)
+      throw memory_fault_t("invalid key", chip8, opcode);
+    break;
+  case op_t::op_F002:
+    check_range(chip8, opcode, AUDIO_PATTERN_SIZE);
+    break;
+  case op_t::op_Fx1E:
+    if (chip8->index + chip8->registers[vx] >= MEMORY_SIZE)
+      throw memory_fault_t("I out of range", chip8, opcode);
+    break;
+  case op_t::op_Fx33:
+    check_range(chip8, opcode, 3);
+    break;
+  case op_t::op_Fx55:
+  case op_t::op_Fx65:
+    check_range(chip8, opcode, vx + 1);
+    break;
+  default:
+    break;
+  }
+
+  run_cycle(chip8);
+}
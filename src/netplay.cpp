@@ -0,0 +1,272 @@
+#include "netplay.h"
+#include "state.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <system_error>
+#include <unistd.h>
+
+static void put_u16(std::vector<uint8_t> &out, uint16_t value) {
+  out.push_back(static_cast<uint8_t>(value));
+  out.push_back(static_cast<uint8_t>(value >> 8u));
+}
+
+static void put_u32(std::vector<uint8_t> &out, uint32_t value) {
+  for (unsigned int i = 0; i < 4; ++i)
+    out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+static void put_u64(std::vector<uint8_t> &out, uint64_t value) {
+  for (unsigned int i = 0; i < 8; ++i)
+    out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+static uint64_t get_bytes(uint8_t const *&in, unsigned int size) {
+  uint64_t value = 0;
+  for (unsigned int i = 0; i < size; ++i)
+    value |= static_cast<uint64_t>(*in++) << (8 * i);
+  return value;
+}
+
+udp_link_t::udp_link_t(uint16_t local_port, std::string const &remote_host,
+                       uint16_t remote_port) {
+  addrinfo hints{};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+  addrinfo *found = nullptr;
+  auto service = std::to_string(static_cast<unsigned int>(remote_port));
+  if (getaddrinfo(remote_host.c_str(), service.c_str(), &hints, &found) != 0)
+    throw std::runtime_error("Cannot resolve " + remote_host + ".");
+  std::memcpy(&remote, found->ai_addr, sizeof(remote));
+  freeaddrinfo(found);
+
+  socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (socket_fd < 0)
+    throw std::system_error(errno, std::generic_category(), "socket");
+
+  sockaddr_in local{};
+  local.sin_family = AF_INET;
+  local.sin_addr.s_addr = htonl(INADDR_ANY);
+  local.sin_port = htons(local_port);
+  // Connecting filters out datagrams from anyone but the peer.
+  if (bind(socket_fd, reinterpret_cast<sockaddr *>(&local), sizeof(local)) ||
+      connect(socket_fd, reinterpret_cast<sockaddr *>(&remote),
+              sizeof(remote)) ||
+      fcntl(socket_fd, F_SETFL, O_NONBLOCK) != 0) {
+    auto error = errno;
+    close(socket_fd);
+    throw std::system_error(error, std::generic_category(), "udp socket");
+  }
+}
+
+udp_link_t::~udp_link_t() { close(socket_fd); }
+
+udp_link_t &udp_link_t::set_latency(std::chrono::microseconds latency) {
+  this->latency = latency;
+  return *this;
+}
+
+udp_link_t &udp_link_t::set_loss(double probability) {
+  probability = std::clamp(probability, 0.0, 1.0);
+  loss_threshold = static_cast<uint32_t>(probability * 4294967295.0);
+  return *this;
+}
+
+udp_link_t &udp_link_t::set_seed(uint32_t seed) {
+  random_state = seed != 0 ? seed : 0x2545F491u;
+  return *this;
+}
+
+void udp_link_t::send(std::vector<uint8_t> packet) {
+  random_state ^= random_state << 13u;
+  random_state ^= random_state >> 17u;
+  random_state ^= random_state << 5u;
+  if (random_state < loss_threshold)
+    return;
+
+  delayed.emplace_back(clock_t::now() + latency, std::move(packet));
+  flush();
+}
+
+void udp_link_t::flush() {
+  auto now = clock_t::now();
+  while (!delayed.empty() && delayed.front().first <= now) {
+    auto const &packet = delayed.front().second;
+    // Best effort, like the network: a full buffer or an absent peer
+    // (ECONNREFUSED) loses the packet.
+    [[maybe_unused]] auto sent =
+        ::send(socket_fd, packet.data(), packet.size(), 0);
+    delayed.pop_front();
+  }
+}
+
+bool udp_link_t::receive(std::vector<uint8_t> &packet) {
+  flush();
+  packet.resize(1024);
+  while (true) {
+    auto size = recv(socket_fd, packet.data(), packet.size(), 0);
+    if (size >= 0) {
+      packet.resize(static_cast<size_t>(size));
+      return true;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      return false;
+    // Reported for an earlier send while the peer was not listening yet.
+    if (errno != ECONNREFUSED && errno != EINTR)
+      throw std::system_error(errno, std::generic_category(), "recv");
+  }
+}
+
+netplay_t::netplay_t(udp_link_t &link) : link(link), snapshots(HISTORY) {}
+
+netplay_t &netplay_t::set_on_confirmed(confirmed_fn_t on_confirmed) {
+  this->on_confirmed = std::move(on_confirmed);
+  return *this;
+}
+
+uint16_t netplay_t::remote_keys(uint64_t frame) const {
+  if (frame < remote_known)
+    return remote_inputs[frame % HISTORY];
+  // Predict that the peer still holds the keys it last sent.
+  return remote_known > 0 ? remote_inputs[(remote_known - 1) % HISTORY] : 0;
+}
+
+void netplay_t::run_frame(chip8_t *chip8, uint64_t frame) {
+  auto slot = frame % HISTORY;
+  snapshots[slot] = *chip8;
+  predicted[slot] = remote_keys(frame);
+
+  auto keys = static_cast<uint16_t>(local_inputs[slot] | predicted[slot]);
+  for (unsigned int key = 0; key < KEY_COUNT; ++key)
+    chip8->keypad[key] = static_cast<uint8_t>((keys >> key) & 1u);
+  for (unsigned int cycle = 0; cycle < CYCLES_PER_FRAME; ++cycle)
+    run_cycle(chip8);
+}
+
+void netplay_t::rollback(chip8_t *chip8, uint64_t from) {
+  auto start = std::chrono::steady_clock::now();
+  *chip8 = snapshots[from % HISTORY];
+  for (auto frame = from; frame < current; ++frame)
+    run_frame(chip8, frame);
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  auto frames = static_cast<unsigned int>(current - from);
+  statistics.rollbacks += 1;
+  statistics.resimulated_frames += frames;
+  statistics.max_rollback = std::max(statistics.max_rollback, frames);
+  statistics.max_rollback_ms =
+      std::max(statistics.max_rollback_ms, elapsed.count());
+}
+
+void netplay_t::receive_packet(std::vector<uint8_t> const &packet) {
+  auto const *in = packet.data();
+  auto const *end = in + packet.size();
+  if (end - in < 9 || get_bytes(in, 4) != NETPLAY_MAGIC)
+    return;
+  uint64_t first = get_bytes(in, 4);
+  unsigned int count = *in++;
+  if (static_cast<size_t>(end - in) != 2u * count + 16u)
+    return;
+
+  for (unsigned int i = 0; i < count; ++i) {
+    auto keys = static_cast<uint16_t>(get_bytes(in, 2));
+    // Frames arrive in order here or not at all; keep only what extends the
+    // known inputs and still fits the history.
+    if (first + i == remote_known && remote_known < confirmed + HISTORY) {
+      remote_inputs[remote_known % HISTORY] = keys;
+      remote_known += 1;
+    }
+  }
+  remote_acked =
+      std::clamp<uint64_t>(get_bytes(in, 4), remote_acked, current);
+
+  uint64_t hash_frame = get_bytes(in, 4);
+  uint64_t hash = get_bytes(in, 8);
+  if (hash_frame > remote_hash_frame) {
+    remote_hash_frame = hash_frame;
+    remote_hash = hash;
+  }
+  statistics.packets_received += 1;
+}
+
+void netplay_t::poll(chip8_t *chip8) {
+  auto known = remote_known;
+  std::vector<uint8_t> packet;
+  while (link.receive(packet))
+    receive_packet(packet);
+
+  // Roll back to the first frame that ran with the wrong keys.
+  auto last = std::min(remote_known, current);
+  for (auto frame = known; frame < last; ++frame) {
+    if (predicted[frame % HISTORY] != remote_inputs[frame % HISTORY]) {
+      rollback(chip8, frame);
+      break;
+    }
+  }
+}
+
+void netplay_t::confirm(chip8_t const *chip8) {
+  auto last = std::min(remote_known, current);
+  for (; confirmed < last; ++confirmed) {
+    // The state after a frame is the snapshot before the next one.
+    auto const *state = confirmed + 1 < current
+                            ? &snapshots[(confirmed + 1) % HISTORY]
+                            : chip8;
+    hashes[confirmed % HISTORY] = hash_state(state).value();
+    if (on_confirmed)
+      on_confirmed(confirmed, state);
+  }
+
+  if (remote_hash_frame > compared_hash_frame &&
+      remote_hash_frame <= confirmed &&
+      confirmed - remote_hash_frame < HISTORY) {
+    if (hashes[(remote_hash_frame - 1) % HISTORY] != remote_hash)
+      statistics.desyncs += 1;
+    compared_hash_frame = remote_hash_frame;
+  }
+}
+
+void netplay_t::send_inputs() {
+  // The peer never needs keys from further back than the history holds.
+  auto first = std::max(remote_acked, current > HISTORY ? current - HISTORY
+                                                        : uint64_t{0});
+  auto count = static_cast<unsigned int>(current - first);
+
+  std::vector<uint8_t> packet;
+  put_u32(packet, NETPLAY_MAGIC);
+  put_u32(packet, static_cast<uint32_t>(first));
+  packet.push_back(static_cast<uint8_t>(count));
+  for (auto frame = first; frame < current; ++frame)
+    put_u16(packet, local_inputs[frame % HISTORY]);
+  put_u32(packet, static_cast<uint32_t>(remote_known));
+  put_u32(packet, static_cast<uint32_t>(confirmed));
+  put_u64(packet, confirmed > 0 ? hashes[(confirmed - 1) % HISTORY] : 0);
+
+  link.send(std::move(packet));
+  statistics.packets_sent += 1;
+}
+
+bool netplay_t::advance(chip8_t *chip8, uint16_t local_keys) {
+  poll(chip8);
+  confirm(chip8);
+
+  bool ran = current < remote_known + NETPLAY_MAX_ROLLBACK;
+  if (ran) {
+    local_inputs[current % HISTORY] = local_keys;
+    run_frame(chip8, current);
+    current += 1;
+    confirm(chip8);
+    statistics.frames += 1;
+  } else {
+    statistics.stalls += 1;
+  }
+  send_inputs();
+
+  for (unsigned int key = 0; key < KEY_COUNT; ++key)
+    chip8->keypad[key] = static_cast<uint8_t>((local_keys >> key) & 1u);
+  return ran;
+}
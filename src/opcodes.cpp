@@ -1,14 +1,18 @@
 #include "chip8.h"
+#include "memory.h"
+#include <algorithm>
 
 static void init_dispatch_table();
 
 static unsigned char has_initialized = 0;
 
 static func_ptr dispatch_table[0xF + 1];
-static func_ptr table0[0xE + 1];
-static func_ptr table8[0xE + 1];
-static func_ptr tableE[0xE + 1];
-static func_ptr tableF[0x65 + 1];
+// The secondary tables cover every value of the nibble or byte that indexes
+// them, so no opcode can read past their end.
+static func_ptr table0[0xF + 1];
+static func_ptr table8[0xF + 1];
+static func_ptr tableE[0xF + 1];
+static func_ptr tableF[0xFF + 1];
 
 static void init_dispatcher() {
   init_dispatch_table();
@@ -22,6 +26,26 @@ func_ptr *make_dispatcher() {
   return dispatch_table;
 }
 
+/**
+ * @brief The handler that finally executes opcode, with the secondary tables
+ * already resolved, for engines that decode ahead of time.
+ */
+func_ptr lookup_handler(uint16_t opcode) {
+  auto dispatcher = make_dispatcher();
+  switch (opcode >> 12u) {
+  case 0x0:
+    return table0[opcode & 0x000Fu];
+  case 0x8:
+    return table8[opcode & 0x000Fu];
+  case 0xE:
+    return tableE[opcode & 0x000Fu];
+  case 0xF:
+    return tableF[opcode & 0x00FFu];
+  default:
+    return dispatcher[opcode >> 12u];
+  }
+}
+
 static uint8_t make_vx(uint16_t opcode) { return ((opcode & 0x0F00u) >> 8u); }
 
 static uint8_t make_vy(uint16_t opcode) { return ((opcode & 0x00F0u) >> 4u); }
@@ -298,12 +322,14 @@ static void op_Cxkk(chip8_t *chip8) {
   uint8_t vx = make_vx(chip8->opcode);
   uint8_t kk = make_kk(chip8->opcode);
 
-  std::default_random_engine e1(static_cast<unsigned long>(
-      std::chrono::system_clock::now().time_since_epoch().count()));
-  std::uniform_int_distribution<uint8_t> uniform_dist{
-      0, std::numeric_limits<uint8_t>::max()};
+  // xorshift32: cheap, and reproducible from the seed kept in chip8_t.
+  uint32_t random = chip8->random_state;
+  random ^= random << 13u;
+  random ^= random >> 17u;
+  random ^= random << 5u;
+  chip8->random_state = random;
 
-  chip8->registers[vx] = (uniform_dist(e1)) & kk;
+  chip8->registers[vx] = static_cast<uint8_t>(random >> 24u) & kk;
 }
 
 struct sprite_t {
@@ -348,9 +374,15 @@ static void op_Dxyn(chip8_t *chip8) {
    * set to unset when the sprite is drawn, and to 0 if that doesn’t happen
    * */
   sprite_t sprite(chip8);
-  for (uint8_t row = 0; row < sprite.sprite_height; ++row) {
+
+  // Clip at the screen edges instead of writing past the framebuffer.
+  unsigned int rows = std::min<unsigned int>(sprite.sprite_height,
+                                             VIDEO_HEIGHT - sprite.sprite_y);
+  unsigned int cols = std::min<unsigned int>(8, VIDEO_WIDTH - sprite.sprite_x);
+
+  for (uint8_t row = 0; row < rows; ++row) {
     uint8_t sprite_row = chip8->memory[chip8->index + row];
-    for (uint8_t col = 0; col < 8; ++col) {
+    for (uint8_t col = 0; col < cols; ++col) {
       uint8_t sprite_pixel = get_sprite_pixel(sprite_row, col);
       uint32_t *video_pixel = get_video_pixel(chip8, &sprite, row, col);
       // Sprite pixel is on
@@ -373,7 +405,7 @@ static void op_Dxyn(chip8_t *chip8) {
  */
 static void op_Ex9E(chip8_t *chip8) {
   uint8_t vx = make_vx(chip8->opcode);
-  uint8_t key = chip8->registers[vx];
+  uint8_t key = chip8->registers[vx] & 0xFu;
 
   if (chip8->keypad[key])
     chip8->pc += 2;
@@ -386,7 +418,7 @@ static void op_Ex9E(chip8_t *chip8) {
  */
 static void op_ExA1(chip8_t *chip8) {
   uint8_t vx = make_vx(chip8->opcode);
-  uint8_t key = chip8->registers[vx];
+  uint8_t key = chip8->registers[vx] & 0xFu;
 
   if (!chip8->keypad[key])
     chip8->pc += 2;
@@ -473,7 +505,7 @@ static void op_Fx18(chip8_t *chip8) {
  */
 static void op_Fx1E(chip8_t *chip8) {
   uint8_t vx = make_vx(chip8->opcode);
-  chip8->index += chip8->registers[vx];
+  chip8->index = (chip8->index + chip8->registers[vx]) & MEMORY_MASK;
 }
 
 /**
@@ -507,12 +539,39 @@ static void op_Fx33(chip8_t *chip8) {
   value /= 10;
 
   chip8->memory[chip8->index] = value % 10;
+
+  commit_write(chip8, chip8->index, 3);
+}
+
+/**
+ * @ingroup table
+ *
+ * @brief XO-CHIP: load the 16-byte audio pattern from memory locations I to
+ * I+15.
+ */
+static void op_F002(chip8_t *chip8) {
+  // Wrap explicitly rather than rely on the memory mirror.
+  for (unsigned int i = 0; i < AUDIO_PATTERN_SIZE; ++i)
+    chip8->audio_pattern[i] = chip8->memory[(chip8->index + i) & MEMORY_MASK];
+  chip8->audio_pattern_loaded = 1;
+}
+
+/**
+ * @ingroup table
+ *
+ * @brief XO-CHIP: set the audio pattern playback pitch = Vx.
+ */
+static void op_Fx3A(chip8_t *chip8) {
+  uint8_t vx = make_vx(chip8->opcode);
+  chip8->audio_pitch = chip8->registers[vx];
 }
 
 static void op_Fx55(chip8_t *chip8) {
   uint8_t vx = make_vx(chip8->opcode);
   for (uint8_t i = 0; i <= vx; ++i)
     chip8->memory[chip8->index + i] = chip8->registers[i];
+
+  commit_write(chip8, chip8->index, vx + 1u);
 }
 
 static void op_Fx65(chip8_t *chip8) {
@@ -562,7 +621,7 @@ static void init_dispatch_table() {
   dispatch_table[0xE] = opcodes_E;
   dispatch_table[0xF] = opcodes_F;
 
-  for (size_t i = 0; i <= 0xE; i++) {
+  for (size_t i = 0; i <= 0xF; i++) {
     table0[i] = op_null;
     table8[i] = op_null;
     tableE[i] = op_null;
@@ -584,10 +643,11 @@ static void init_dispatch_table() {
   tableE[0x1] = op_ExA1;
   tableE[0xE] = op_Ex9E;
 
-  for (size_t i = 0; i <= 0x65; i++) {
+  for (size_t i = 0; i <= 0xFF; i++) {
     tableF[i] = op_null;
   }
 
+  tableF[0x02] = op_F002;
   tableF[0x07] = op_Fx07;
   tableF[0x0A] = op_Fx0A;
   tableF[0x15] = op_Fx15;
@@ -595,6 +655,7 @@ static void init_dispatch_table() {
   tableF[0x1E] = op_Fx1E;
   tableF[0x29] = op_Fx29;
   tableF[0x33] = op_Fx33;
+  tableF[0x3A] = op_Fx3A;
   tableF[0x55] = op_Fx55;
   tableF[0x65] = op_Fx65;
 }
\ No newline at end of file
@@ -0,0 +1,99 @@
+#include "profiler.h"
+#include "analyzer.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+static std::string hex(unsigned int value) {
+  char buffer[16];
+  std::snprintf(buffer, sizeof(buffer), "%03X", value);
+  return buffer;
+}
+
+profiler_t::profiler_t(unsigned int interval)
+    : interval(std::max(interval, 1u)), countdown(this->interval) {}
+
+profiler_t &profiler_t::add_symbols(analysis_t const &analysis) {
+  entry = analysis.entry;
+  symbols.emplace(analysis.entry, "main");
+  for (auto address : analysis.subroutines)
+    symbols.emplace(address, "sub_" + hex(address));
+  return *this;
+}
+
+/**
+ * @brief Read "<address> <name>" lines, e.g. "0x2A4 draw_player". Names from
+ * the file replace the ones derived by the analyzer.
+ */
+profiler_t &profiler_t::load_symbols(path_t const &filename) {
+  std::ifstream file(filename);
+  if (!file.is_open())
+    throw std::runtime_error("Cannot open " + filename.string() + ".");
+
+  std::string line;
+  for (unsigned int number = 1; std::getline(file, line); ++number) {
+    std::istringstream fields(line);
+    std::string address, name;
+    if (!(fields >> address >> name) || address[0] == '#')
+      continue;
+
+    // A bad entry costs one symbol, not the whole profile.
+    size_t parsed = 0;
+    unsigned long value = MEMORY_SIZE;
+    try {
+      value = std::stoul(address, &parsed, 0);
+    } catch (std::logic_error const &) {
+    }
+    if (parsed != address.size() || value >= MEMORY_SIZE) {
+      std::cerr << filename.string() << ":" << number
+                << ": bad address '" << address << "', skipped\n";
+      continue;
+    }
+    symbols[static_cast<uint16_t>(value)] = name;
+  }
+  return *this;
+}
+
+void profiler_t::run(chip8_t *chip8) {
+  run_cycle(chip8);
+  if (--countdown == 0) {
+    countdown = interval;
+    sample(chip8);
+  }
+}
+
+void profiler_t::sample(chip8_t const *chip8) {
+  std::vector<uint16_t> frames{entry};
+
+  // Each return address follows the 2nnn that pushed it; its nnn is the
+  // subroutine running one level deeper.
+  auto depth = std::min<unsigned int>(chip8->sp, STACK_SIZE);
+  for (unsigned int level = 0; level < depth; ++level) {
+    auto call = (chip8->stack[level] - 2u) % MEMORY_SIZE;
+    auto nnn = ((chip8->memory[call] << 8u) |
+                chip8->memory[(call + 1) % MEMORY_SIZE]) &
+               0x0FFFu;
+    frames.push_back(static_cast<uint16_t>(nnn));
+  }
+
+  frames.push_back(chip8->pc);
+  samples[frames] += 1;
+}
+
+std::string profiler_t::symbol(uint16_t address) const {
+  auto found = symbols.find(address);
+  if (found != symbols.end())
+    return found->second;
+  return address == entry ? "main" : "sub_" + hex(address);
+}
+
+void profiler_t::write_collapsed(std::ostream &out) const {
+  for (auto const &[frames, count] : samples) {
+    for (size_t i = 0; i + 1 < frames.size(); ++i)
+      out << symbol(frames[i]) << ";";
+    out << "0x" << hex(frames.back()) << " " << count << "\n";
+  }
+}
@@ -0,0 +1,318 @@
+#include "recorder.h"
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <stdexcept>
+
+#ifdef CHIP8_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+const size_t RECORDING_HEADER_SIZE = 16;
+const size_t RECORDING_TRAILER_SIZE = 12;
+
+static void put_uint(std::vector<uint8_t> &out, uint64_t value,
+                     unsigned int bytes) {
+  for (unsigned int i = 0; i < bytes; ++i)
+    out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+static uint64_t get_uint(std::vector<uint8_t> const &in, size_t offset,
+                         unsigned int bytes) {
+  if (offset + bytes > in.size())
+    throw std::runtime_error("Truncated recording.");
+
+  uint64_t value = 0;
+  for (unsigned int i = 0; i < bytes; ++i)
+    value |= static_cast<uint64_t>(in[offset + i]) << (8 * i);
+  return value;
+}
+
+static void put_varint(std::vector<uint8_t> &out, size_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value | 0x80u));
+    value >>= 7u;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+static size_t get_varint(uint8_t const *&in, uint8_t const *end) {
+  size_t value = 0;
+  for (unsigned int shift = 0; in != end && shift < 64; shift += 7) {
+    auto byte = *in++;
+    value |= static_cast<size_t>(byte & 0x7Fu) << shift;
+    if ((byte & 0x80u) == 0)
+      return value;
+  }
+  throw std::runtime_error("Corrupt recording record.");
+}
+
+static void rle_encode(uint8_t const *frame, std::vector<uint8_t> &out) {
+  size_t i = 0;
+  while (i < PACKED_VIDEO_SIZE) {
+    auto zeros = i;
+    while (zeros < PACKED_VIDEO_SIZE && frame[zeros] == 0)
+      ++zeros;
+    auto literals = zeros;
+    while (literals < PACKED_VIDEO_SIZE && frame[literals] != 0)
+      ++literals;
+
+    put_varint(out, zeros - i);
+    put_varint(out, literals - zeros);
+    out.insert(out.end(), frame + zeros, frame + literals);
+    i = literals;
+  }
+}
+
+static void rle_decode(uint8_t const *in, uint8_t const *end, uint8_t *frame) {
+  size_t i = 0;
+  while (i < PACKED_VIDEO_SIZE) {
+    auto zeros = get_varint(in, end);
+    auto literals = get_varint(in, end);
+    if (i + zeros + literals > PACKED_VIDEO_SIZE ||
+        literals > static_cast<size_t>(end - in))
+      throw std::runtime_error("Corrupt recording record.");
+
+    std::fill_n(frame + i, zeros, 0);
+    i += zeros;
+    std::copy_n(in, literals, frame + i);
+    in += literals;
+    i += literals;
+  }
+}
+
+recorder_t::recorder_t(path_t const &filename, unsigned int keyframe_interval,
+                       size_t queue_frames)
+    : file(filename, std::ios::binary),
+      keyframe_interval(std::max(keyframe_interval, 1u)),
+      queue(queue_frames) {
+  if (!file.is_open())
+    throw std::runtime_error("Cannot open " + filename.string() + ".");
+
+  std::vector<uint8_t> header;
+  put_uint(header, RECORDING_MAGIC, 4);
+  put_uint(header, RECORDING_VERSION, 4);
+  put_uint(header, this->keyframe_interval, 4);
+  put_uint(header, VIDEO_WIDTH, 2);
+  put_uint(header, VIDEO_HEIGHT, 2);
+  file.write(reinterpret_cast<char const *>(header.data()),
+             static_cast<std::streamsize>(header.size()));
+
+  encoder = std::thread([this] { encode(); });
+}
+
+recorder_t::~recorder_t() {
+  closing = true;
+  encoder.join();
+
+  std::vector<uint8_t> index;
+  auto index_offset = static_cast<uint64_t>(file.tellp());
+  put_uint(index, frames, 8);
+  put_uint(index, keyframes.size(), 4);
+  for (auto [frame, offset] : keyframes) {
+    put_uint(index, frame, 8);
+    put_uint(index, offset, 8);
+  }
+  put_uint(index, index_offset, 8);
+  put_uint(index, RECORDING_MAGIC, 4);
+  file.write(reinterpret_cast<char const *>(index.data()),
+             static_cast<std::streamsize>(index.size()));
+}
+
+void recorder_t::capture(chip8_t const *chip8) {
+  packed_frame_t frame;
+  pack_video(chip8->video, frame.pixels);
+  if (!queue.push(frame))
+    dropped += 1;
+}
+
+void recorder_t::encode() {
+  std::vector<uint8_t> payload;
+  packed_frame_t frame;
+
+  while (true) {
+    // Read closing before draining so frames pushed before the destructor
+    // ran are never left behind.
+    bool last = closing;
+    while (queue.pop(frame)) {
+      payload.clear();
+      auto type = frames % keyframe_interval == 0 ? RECORD_KEYFRAME
+                                                  : RECORD_DELTA;
+      if (type == RECORD_KEYFRAME) {
+        keyframes.emplace_back(frames, static_cast<uint64_t>(file.tellp()));
+        rle_encode(frame.pixels, payload);
+      } else {
+        packed_frame_t delta;
+        for (unsigned int i = 0; i < PACKED_VIDEO_SIZE; ++i)
+          delta.pixels[i] = frame.pixels[i] ^ previous.pixels[i];
+        rle_encode(delta.pixels, payload);
+      }
+
+      write_record(type, payload);
+      previous = frame;
+      frames += 1;
+    }
+
+    if (last)
+      return;
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+}
+
+void recorder_t::write_record(uint8_t type,
+                              std::vector<uint8_t> const &payload) {
+  auto const *body = &payload;
+
+#ifdef CHIP8_HAVE_ZSTD
+  // Deltas are usually a few bytes; only larger records gain from zstd.
+  std::vector<uint8_t> compressed;
+  if (payload.size() > 32) {
+    compressed.resize(ZSTD_compressBound(payload.size()));
+    auto size = ZSTD_compress(compressed.data(), compressed.size(),
+                              payload.data(), payload.size(), 3);
+    if (!ZSTD_isError(size) && size < payload.size()) {
+      compressed.resize(size);
+      body = &compressed;
+      type |= RECORD_ZSTD;
+    }
+  }
+#endif
+
+  std::vector<uint8_t> header;
+  put_uint(header, type, 1);
+  put_uint(header, body->size(), 4);
+  file.write(reinterpret_cast<char const *>(header.data()),
+             static_cast<std::streamsize>(header.size()));
+  file.write(reinterpret_cast<char const *>(body->data()),
+             static_cast<std::streamsize>(body->size()));
+}
+
+recording_reader_t::recording_reader_t(path_t const &filename) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file.is_open())
+    throw std::runtime_error("Cannot open " + filename.string() + ".");
+  data.assign(std::istreambuf_iterator<char>(file),
+              std::istreambuf_iterator<char>());
+
+  if (get_uint(data, 0, 4) != RECORDING_MAGIC)
+    throw std::runtime_error(filename.string() + " is not a recording.");
+  if (get_uint(data, 4, 4) != RECORDING_VERSION)
+    throw std::runtime_error("Unsupported recording version.");
+  if (get_uint(data, 12, 2) != VIDEO_WIDTH ||
+      get_uint(data, 14, 2) != VIDEO_HEIGHT)
+    throw std::runtime_error("Unsupported recording resolution.");
+  interval = static_cast<unsigned int>(get_uint(data, 8, 4));
+
+  auto size = data.size();
+  if (size >= RECORDING_HEADER_SIZE + RECORDING_TRAILER_SIZE &&
+      get_uint(data, size - 4, 4) == RECORDING_MAGIC) {
+    records_end = get_uint(data, size - RECORDING_TRAILER_SIZE, 8);
+    if (records_end < RECORDING_HEADER_SIZE ||
+        records_end > size - RECORDING_TRAILER_SIZE)
+      throw std::runtime_error("Corrupt recording trailer.");
+    frames = get_uint(data, records_end, 8);
+    auto count = get_uint(data, records_end + 8, 4);
+    if (count > (size - records_end) / 16)
+      throw std::runtime_error("Corrupt recording trailer.");
+    for (uint64_t i = 0; i < count; ++i) {
+      auto entry = records_end + 12 + i * 16;
+      auto first = get_uint(data, entry, 8);
+      auto at = get_uint(data, entry + 8, 8);
+      // seek() bisects the index, so it has to be in frame order.
+      if (first >= frames || at < RECORDING_HEADER_SIZE ||
+          at >= records_end ||
+          (!keyframes.empty() && first <= keyframes.back().first))
+        throw std::runtime_error("Corrupt recording keyframe index.");
+      keyframes.emplace_back(first, at);
+    }
+  } else {
+    scan_records();
+  }
+
+  offset = RECORDING_HEADER_SIZE;
+}
+
+void recording_reader_t::scan_records() {
+  size_t at = RECORDING_HEADER_SIZE;
+  while (at + 5 <= data.size()) {
+    auto type = data[at] & ~RECORD_ZSTD;
+    auto length = get_uint(data, at + 1, 4);
+    if ((type != RECORD_KEYFRAME && type != RECORD_DELTA) ||
+        at + 5 + length > data.size())
+      break;
+    if (type == RECORD_KEYFRAME)
+      keyframes.emplace_back(frames, at);
+    frames += 1;
+    at += 5 + length;
+  }
+  records_end = at;
+}
+
+bool recording_reader_t::next(uint8_t *packed) {
+  if (position >= frames || offset + 5 > records_end)
+    return false;
+
+  auto type = data[offset];
+  auto length = get_uint(data, offset + 1, 4);
+  if (length > records_end - offset - 5)
+    throw std::runtime_error("Truncated recording.");
+  uint8_t const *body = data.data() + offset + 5;
+  uint8_t const *end = body + length;
+
+#ifdef CHIP8_HAVE_ZSTD
+  std::vector<uint8_t> decompressed;
+  if (type & RECORD_ZSTD) {
+    auto size = ZSTD_getFrameContentSize(body, length);
+    if (size == ZSTD_CONTENTSIZE_ERROR || size == ZSTD_CONTENTSIZE_UNKNOWN)
+      throw std::runtime_error("Corrupt recording record.");
+    decompressed.resize(size);
+    auto result =
+        ZSTD_decompress(decompressed.data(), decompressed.size(), body, length);
+    if (ZSTD_isError(result))
+      throw std::runtime_error("Corrupt recording record.");
+    body = decompressed.data();
+    end = body + decompressed.size();
+  }
+#else
+  if (type & RECORD_ZSTD)
+    throw std::runtime_error("Recording needs zstd support.");
+#endif
+
+  if ((type & ~RECORD_ZSTD) == RECORD_KEYFRAME) {
+    rle_decode(body, end, current.pixels);
+  } else {
+    packed_frame_t delta;
+    rle_decode(body, end, delta.pixels);
+    for (unsigned int i = 0; i < PACKED_VIDEO_SIZE; ++i)
+      current.pixels[i] ^= delta.pixels[i];
+  }
+
+  offset += 5 + length;
+  position += 1;
+  std::copy_n(current.pixels, PACKED_VIDEO_SIZE, packed);
+  return true;
+}
+
+void recording_reader_t::seek(uint64_t frame, uint8_t *packed) {
+  if (frame >= frames)
+    throw std::out_of_range("Frame past the end of the recording.");
+
+  auto keyframe = std::upper_bound(
+      keyframes.begin(), keyframes.end(), frame,
+      [](uint64_t frame, auto const &entry) { return frame < entry.first; });
+  if (keyframe == keyframes.begin())
+    throw std::runtime_error("Recording has no keyframe.");
+  --keyframe;
+
+  // Replaying from the current position is cheaper when it is already past
+  // the keyframe and not past the target.
+  if (position > frame || position <= keyframe->first) {
+    position = keyframe->first;
+    offset = keyframe->second;
+  }
+
+  uint8_t scratch[PACKED_VIDEO_SIZE];
+  while (position <= frame)
+    if (!next(position == frame ? packed : scratch))
+      throw std::runtime_error("Truncated recording.");
+}
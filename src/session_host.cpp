@@ -0,0 +1,153 @@
+#include "session_host.h"
+#include <algorithm>
+
+session_task_t &session_task_t::operator=(session_task_t &&other) noexcept {
+  if (this != &other) {
+    if (handle)
+      handle.destroy();
+    handle = std::exchange(other.handle, {});
+  }
+  return *this;
+}
+
+session_task_t::~session_task_t() {
+  if (handle)
+    handle.destroy();
+}
+
+session_host_t::session_host_t(unsigned int threads)
+    : threads(std::max(threads, 1u)) {}
+
+session_host_t::~session_host_t() { stop(); }
+
+session_host_t &
+session_host_t::set_frame_period(session_clock_t::duration period) {
+  frame_period = period;
+  return *this;
+}
+
+session_host_t &session_host_t::set_cycles_per_frame(unsigned int cycles) {
+  cycles_per_frame = cycles;
+  return *this;
+}
+
+session_host_t &session_host_t::set_on_frame(frame_fn_t on_frame) {
+  this->on_frame = std::move(on_frame);
+  return *this;
+}
+
+size_t session_host_t::add(chip8_ptr_t chip8) {
+  auto session = std::make_unique<session_t>();
+  session->chip8 = std::move(chip8);
+  session->task = play(*session);
+
+  size_t id;
+  {
+    std::lock_guard lock(mutex);
+    id = sessions.size();
+    session->id = id;
+    ready.push({session_clock_t::now(), session.get()});
+    sessions.push_back(std::move(session));
+    live += 1;
+  }
+  wake.notify_one();
+  return id;
+}
+
+void session_host_t::run() {
+  std::vector<std::thread> workers;
+  for (unsigned int i = 1; i < threads; ++i)
+    workers.emplace_back([this] { work(); });
+  work();
+  for (auto &worker : workers)
+    worker.join();
+}
+
+void session_host_t::stop() {
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+}
+
+size_t session_host_t::size() const {
+  std::lock_guard lock(mutex);
+  return sessions.size();
+}
+
+session_stats_t session_host_t::stats(size_t session) const {
+  std::lock_guard lock(mutex);
+  return sessions.at(session)->stats;
+}
+
+session_task_t session_host_t::play(session_t &session) {
+  auto *chip8 = session.chip8.get();
+  auto deadline = session_clock_t::now();
+
+  while (true) {
+    for (unsigned int i = 0; i < cycles_per_frame; ++i)
+      run_cycle(chip8);
+    if (on_frame && on_frame(session.id, chip8))
+      co_return;
+
+    deadline += frame_period;
+    auto now = session_clock_t::now();
+    if (now - deadline > frame_period)
+      deadline = now;
+    co_await next_frame_t{deadline};
+  }
+}
+
+void session_host_t::work() {
+  std::unique_lock lock(mutex);
+  while (!stopping && live > 0) {
+    if (ready.empty()) {
+      wake.wait(lock);
+      continue;
+    }
+
+    auto next = ready.top();
+    auto now = session_clock_t::now();
+    if (next.deadline > now) {
+      wake.wait_until(lock, next.deadline);
+      continue;
+    }
+    ready.pop();
+
+    auto &session = *next.session;
+    auto lateness = now - next.deadline;
+    session.stats.max_lateness = std::max(session.stats.max_lateness, lateness);
+    if (lateness > frame_period)
+      session.stats.late_frames += 1;
+
+    // Waking another worker here lets it wait for the new earliest deadline
+    // while this one plays the frame.
+    if (!ready.empty())
+      wake.notify_one();
+
+    lock.unlock();
+    auto handle = session.task.handle;
+    handle.resume();
+    lock.lock();
+
+    session.stats.frames += 1;
+    if (handle.done()) {
+      session.stats.finished = true;
+      if (auto error = handle.promise().error) {
+        try {
+          std::rethrow_exception(error);
+        } catch (std::exception const &exception) {
+          session.stats.error = exception.what();
+        } catch (...) {
+          session.stats.error = "unknown exception";
+        }
+      }
+      if (--live == 0)
+        wake.notify_all();
+    } else {
+      ready.push({handle.promise().deadline, &session});
+      wake.notify_one();
+    }
+  }
+}
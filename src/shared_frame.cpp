@@ -0,0 +1,137 @@
+#include "shared_frame.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <system_error>
+#include <unistd.h>
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+              "Shared-memory atomics must be lock-free.");
+
+static std::string segment_name(std::string name) {
+  if (name.empty())
+    throw std::invalid_argument("Shared-memory name must not be empty.");
+  // POSIX shared-memory object names start with a single slash.
+  return name.front() == '/' ? name : "/" + name;
+}
+
+static shared_segment_t *map_segment(int fd) {
+  auto address = mmap(nullptr, sizeof(shared_segment_t),
+                      PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (address == MAP_FAILED)
+    throw std::system_error(errno, std::generic_category(), "mmap");
+  return static_cast<shared_segment_t *>(address);
+}
+
+shared_frame_writer_t::shared_frame_writer_t(std::string name)
+    : name(segment_name(std::move(name))) {
+  // Exclusive: two writers on one segment would both drive the seqlock.
+  auto fd = shm_open(this->name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0 && errno == EEXIST)
+    throw std::runtime_error(
+        "Shared-memory segment " + this->name +
+        " already exists: another writer uses it, or one exited without "
+        "removing it (delete /dev/shm" + this->name + ").");
+  if (fd < 0)
+    throw std::system_error(errno, std::generic_category(), this->name);
+
+  if (ftruncate(fd, sizeof(shared_segment_t)) != 0) {
+    auto error = errno;
+    close(fd);
+    throw std::system_error(error, std::generic_category(), "ftruncate");
+  }
+
+  segment = map_segment(fd);
+  segment->magic = SHARED_FRAME_MAGIC;
+  segment->version = SHARED_FRAME_VERSION;
+  segment->sequence.store(0, std::memory_order_relaxed);
+  segment->injected_keys.store(0, std::memory_order_release);
+}
+
+shared_frame_writer_t::~shared_frame_writer_t() {
+  munmap(segment, sizeof(shared_segment_t));
+  shm_unlink(name.c_str());
+}
+
+void shared_frame_writer_t::publish(chip8_t const *chip8) {
+  auto sequence = segment->sequence.load(std::memory_order_relaxed);
+  segment->sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  auto &shared = segment->frame;
+  shared.frame = ++frame;
+  std::memcpy(shared.video, chip8->video, sizeof(shared.video));
+  std::memcpy(shared.registers, chip8->registers, sizeof(shared.registers));
+  shared.index = chip8->index;
+  shared.pc = chip8->pc;
+  shared.delay_timer = chip8->delay_timer;
+  shared.sound_timer = chip8->sound_timer;
+  std::memcpy(shared.stack, chip8->stack, sizeof(shared.stack));
+  shared.sp = chip8->sp;
+  std::memcpy(shared.keypad, chip8->keypad, sizeof(shared.keypad));
+
+  segment->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+/**
+ * @brief Apply keys pressed or released by consumers since the last call.
+ * Only changes are written, so local input on other keys is left alone.
+ */
+void shared_frame_writer_t::apply_input(chip8_t *chip8) {
+  auto keys = segment->injected_keys.load(std::memory_order_acquire);
+  auto changed = keys ^ applied_keys;
+  if (changed == 0)
+    return;
+
+  for (unsigned int key = 0; key < KEY_COUNT; ++key) {
+    if (changed & (1u << key))
+      chip8->keypad[key] = static_cast<uint8_t>((keys >> key) & 1u);
+  }
+  applied_keys = keys;
+}
+
+shared_frame_reader_t::shared_frame_reader_t(std::string const &name) {
+  auto fd = shm_open(segment_name(name).c_str(), O_RDWR, 0);
+  if (fd < 0)
+    throw std::system_error(errno, std::generic_category(), name);
+
+  segment = map_segment(fd);
+  if (segment->magic != SHARED_FRAME_MAGIC ||
+      segment->version != SHARED_FRAME_VERSION) {
+    munmap(segment, sizeof(shared_segment_t));
+    throw std::runtime_error("Unsupported shared frame segment.");
+  }
+}
+
+shared_frame_reader_t::~shared_frame_reader_t() {
+  munmap(segment, sizeof(shared_segment_t));
+}
+
+bool shared_frame_reader_t::read(machine_frame_t &frame,
+                                 uint64_t last_frame) const {
+  while (true) {
+    auto before = segment->sequence.load(std::memory_order_acquire);
+    if (before & 1u)
+      continue;
+
+    auto current = segment->frame.frame;
+    if (current != last_frame)
+      std::memcpy(&frame, &segment->frame, sizeof(frame));
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (segment->sequence.load(std::memory_order_relaxed) == before)
+      return current != last_frame;
+  }
+}
+
+void shared_frame_reader_t::press(uint8_t key) {
+  segment->injected_keys.fetch_or(1u << (key % KEY_COUNT),
+                                  std::memory_order_release);
+}
+
+void shared_frame_reader_t::release(uint8_t key) {
+  segment->injected_keys.fetch_and(~(1u << (key % KEY_COUNT)),
+                                   std::memory_order_release);
+}
@@ -0,0 +1,73 @@
+#include "state.h"
+
+const uint64_t STATE_HASH_MULTIPLIER = 0x9E3779B97F4A7C15u;
+
+static uint64_t mix(uint64_t hash, uint64_t word) {
+  hash = (hash ^ word) * STATE_HASH_MULTIPLIER;
+  return hash ^ (hash >> 32u);
+}
+
+/**
+ * @brief Multiply-xorshift over 8-byte words, with the tail zero-padded.
+ * Fast rather than cryptographic; collisions only merge explored states.
+ */
+uint64_t hash_bytes(void const *data, size_t size, uint64_t seed) {
+  auto const *bytes = static_cast<uint8_t const *>(data);
+  uint64_t hash = mix(seed, size);
+
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, bytes + i, 8);
+    hash = mix(hash, word);
+  }
+  if (i < size) {
+    uint64_t word = 0;
+    std::memcpy(&word, bytes + i, size - i);
+    hash = mix(hash, word);
+  }
+  return mix(hash, 0);
+}
+
+static uint64_t hash_core(chip8_t const *chip8) {
+  uint8_t core[64];
+  size_t size = 0;
+
+  auto put = [&](void const *field, size_t length) {
+    std::memcpy(core + size, field, length);
+    size += length;
+  };
+  put(chip8->registers, sizeof(chip8->registers));
+  put(&chip8->index, sizeof(chip8->index));
+  put(&chip8->pc, sizeof(chip8->pc));
+  put(&chip8->delay_timer, 1);
+  put(&chip8->sound_timer, 1);
+  put(&chip8->sp, 1);
+  put(&chip8->random_state, sizeof(chip8->random_state));
+  put(&chip8->audio_pitch, 1);
+  put(&chip8->audio_pattern_loaded, 1);
+  put(chip8->audio_pattern, sizeof(chip8->audio_pattern));
+
+  return hash_bytes(chip8->stack, chip8->sp * sizeof(chip8->stack[0]),
+                    hash_bytes(core, size));
+}
+
+uint64_t state_hash_t::value() const {
+  return mix(mix(mix(0, core), memory), video);
+}
+
+state_hash_t hash_state(chip8_t const *chip8) {
+  return {hash_core(chip8), hash_bytes(chip8->memory, MEMORY_SIZE),
+          hash_bytes(chip8->video, sizeof(chip8->video))};
+}
+
+state_hash_t rehash_state(chip8_t const *chip8, state_hash_t const &previous,
+                          state_dirty_t dirty) {
+  state_hash_t hash = previous;
+  hash.core = hash_core(chip8);
+  if (dirty.memory)
+    hash.memory = hash_bytes(chip8->memory, MEMORY_SIZE);
+  if (dirty.video)
+    hash.video = hash_bytes(chip8->video, sizeof(chip8->video));
+  return hash;
+}
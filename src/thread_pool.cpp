@@ -0,0 +1,72 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+thread_pool_t::thread_pool_t(unsigned int threads) {
+  for (unsigned int i = 1; i < std::max(threads, 1u); ++i)
+    workers.emplace_back([this] { work(); });
+}
+
+thread_pool_t::~thread_pool_t() {
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto &worker : workers)
+    worker.join();
+}
+
+void thread_pool_t::parallel_for(size_t count,
+                                 std::function<void(size_t)> const &body,
+                                 size_t chunk) {
+  if (count == 0)
+    return;
+
+  {
+    std::lock_guard lock(mutex);
+    job = &body;
+    job_count = count;
+    job_chunk = std::max<size_t>(chunk, 1);
+    next.store(0, std::memory_order_relaxed);
+    active = static_cast<unsigned int>(workers.size());
+    generation += 1;
+  }
+  wake.notify_all();
+
+  run_chunks();
+
+  std::unique_lock lock(mutex);
+  finished.wait(lock, [this] { return active == 0; });
+  job = nullptr;
+}
+
+void thread_pool_t::run_chunks() {
+  while (true) {
+    auto first = next.fetch_add(job_chunk, std::memory_order_relaxed);
+    if (first >= job_count)
+      return;
+
+    auto last = std::min(first + job_chunk, job_count);
+    for (auto i = first; i < last; ++i)
+      (*job)(i);
+  }
+}
+
+void thread_pool_t::work() {
+  uint64_t seen = 0;
+  while (true) {
+    {
+      std::unique_lock lock(mutex);
+      wake.wait(lock, [&] { return stopping || generation != seen; });
+      if (stopping)
+        return;
+      seen = generation;
+    }
+
+    run_chunks();
+
+    std::lock_guard lock(mutex);
+    if (--active == 0)
+      finished.notify_one();
+  }
+}
@@ -0,0 +1,303 @@
+#include "trace.h"
+#include <chrono>
+#include <stdexcept>
+
+#ifdef CHIP8_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+const size_t TRACE_CHUNK_RECORDS = 4096;
+
+static void put_varint(std::vector<uint8_t> &out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value | 0x80u));
+    value >>= 7u;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+static uint64_t get_varint(uint8_t const *&in, uint8_t const *end) {
+  uint64_t value = 0;
+  for (unsigned int shift = 0; in != end && shift < 64; shift += 7) {
+    auto byte = *in++;
+    value |= static_cast<uint64_t>(byte & 0x7Fu) << shift;
+    if ((byte & 0x80u) == 0)
+      return value;
+  }
+  throw std::runtime_error("Corrupt trace chunk.");
+}
+
+static uint64_t read_varint(std::istream &in) {
+  uint64_t value = 0;
+  for (unsigned int shift = 0; shift < 64; shift += 7) {
+    auto byte = in.get();
+    if (byte == std::char_traits<char>::eof())
+      throw std::runtime_error("Truncated trace.");
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0)
+      return value;
+  }
+  throw std::runtime_error("Corrupt trace chunk.");
+}
+
+static uint64_t zigzag(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1u) ^
+         static_cast<uint64_t>(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+  return static_cast<int64_t>(value >> 1u) ^ -static_cast<int64_t>(value & 1u);
+}
+
+tracer_t::tracer_t(path_t const &filename, size_t stream_capacity)
+    : file(filename, std::ios::binary), stream_capacity(stream_capacity) {
+  if (!file.is_open())
+    throw std::runtime_error("Cannot open " + filename.string() + ".");
+
+  uint8_t header[8];
+  for (unsigned int i = 0; i < 4; ++i) {
+    header[i] = static_cast<uint8_t>(TRACE_MAGIC >> (8 * i));
+    header[4 + i] = static_cast<uint8_t>(TRACE_VERSION >> (8 * i));
+  }
+  file.write(reinterpret_cast<char const *>(header), sizeof(header));
+
+  writer = std::thread([this] { write(); });
+}
+
+tracer_t::~tracer_t() {
+  closing = true;
+  writer.join();
+}
+
+trace_stream_t &tracer_t::open_stream() {
+  std::lock_guard lock(mutex);
+  auto id = static_cast<uint32_t>(streams.size());
+  streams.push_back(std::make_unique<trace_stream_t>(id, stream_capacity));
+  return *streams.back();
+}
+
+uint64_t tracer_t::lost_records() const {
+  std::lock_guard lock(mutex);
+  uint64_t lost = 0;
+  for (auto const &stream : streams)
+    lost += stream->lost.load(std::memory_order_relaxed);
+  return lost;
+}
+
+void tracer_t::write() {
+  std::vector<trace_record_t> records(TRACE_CHUNK_RECORDS);
+  while (true) {
+    // Read closing before draining so batches flushed before the destructor
+    // ran are never left behind.
+    bool last = closing;
+    bool wrote = drain(records);
+    if (last)
+      return;
+    if (!wrote)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+bool tracer_t::drain(std::vector<trace_record_t> &records) {
+  std::vector<trace_stream_t *> open;
+  {
+    std::lock_guard lock(mutex);
+    for (auto const &stream : streams)
+      open.push_back(stream.get());
+  }
+
+  bool wrote = false;
+  for (auto *stream : open) {
+    while (true) {
+      auto count = stream->buffer.pop(records.data(), records.size());
+      auto lost = stream->lost.load(std::memory_order_relaxed);
+      if (count == 0 && lost == stream->lost_reported)
+        break;
+      write_chunk(*stream, records.data(), count);
+      wrote = true;
+    }
+  }
+  return wrote;
+}
+
+static uint8_t *put_varint(uint8_t *out, uint64_t value) {
+  while (value >= 0x80) {
+    *out++ = static_cast<uint8_t>(value | 0x80u);
+    value >>= 7u;
+  }
+  *out++ = static_cast<uint8_t>(value);
+  return out;
+}
+
+void tracer_t::write_chunk(trace_stream_t &stream,
+                           trace_record_t const *records, size_t count) {
+  // Worst case per record: 10-byte cycle delta, 3-byte pc delta, opcode,
+  // register byte and a range of all sixteen registers.
+  payload.resize(count * 34);
+  auto *out = payload.data();
+
+  uint64_t cycle = 0;
+  uint32_t expected_pc = 0;
+  for (size_t i = 0; i < count; ++i) {
+    auto const &record = records[i];
+    out = put_varint(out, record.cycle - cycle);
+    out = put_varint(out, zigzag(static_cast<int64_t>(record.pc) -
+                                 static_cast<int64_t>(expected_pc)));
+    *out++ = static_cast<uint8_t>(record.opcode >> 8u);
+    *out++ = static_cast<uint8_t>(record.opcode);
+
+    if (record.reg == TRACE_NO_REGISTER) {
+      *out++ = TRACE_NO_REGISTER;
+    } else if (record.reg == TRACE_INDEX) {
+      *out++ = TRACE_INDEX;
+      out = put_varint(out, record.index);
+    } else {
+      auto range = record.last != record.reg;
+      *out++ = static_cast<uint8_t>(record.reg | (range ? TRACE_RANGE : 0) |
+                                    (record.flag ? TRACE_FLAG : 0));
+      if (range)
+        *out++ = record.last;
+      for (unsigned int reg = record.reg; reg <= record.last; ++reg)
+        *out++ = record.registers[reg];
+      if (record.flag)
+        *out++ = record.registers[0xF];
+    }
+
+    cycle = record.cycle;
+    expected_pc = record.pc + 2u;
+  }
+  payload.resize(static_cast<size_t>(out - payload.data()));
+
+  uint8_t flags = 0;
+#ifdef CHIP8_HAVE_ZSTD
+  compressed.resize(ZSTD_compressBound(payload.size()));
+  auto size = ZSTD_compress(compressed.data(), compressed.size(),
+                            payload.data(), payload.size(), 1);
+  auto const *body = &payload;
+  if (!ZSTD_isError(size) && size < payload.size()) {
+    compressed.resize(size);
+    body = &compressed;
+    flags |= TRACE_CHUNK_ZSTD;
+  }
+#else
+  auto const *body = &payload;
+#endif
+
+  // lost is only ever increased by the producer, so reading it after the
+  // pop may attribute a few drops to this chunk instead of the next.
+  auto lost = stream.lost.load(std::memory_order_relaxed);
+  std::vector<uint8_t> header{flags};
+  put_varint(header, stream.id);
+  put_varint(header, count);
+  put_varint(header, lost - stream.lost_reported);
+  put_varint(header, body->size());
+  stream.lost_reported = lost;
+
+  file.write(reinterpret_cast<char const *>(header.data()),
+             static_cast<std::streamsize>(header.size()));
+  file.write(reinterpret_cast<char const *>(body->data()),
+             static_cast<std::streamsize>(body->size()));
+}
+
+trace_reader_t::trace_reader_t(path_t const &filename)
+    : file(filename, std::ios::binary) {
+  if (!file.is_open())
+    throw std::runtime_error("Cannot open " + filename.string() + ".");
+
+  uint8_t header[8]{};
+  file.read(reinterpret_cast<char *>(header), sizeof(header));
+  uint32_t magic = 0, version = 0;
+  for (unsigned int i = 0; i < 4; ++i) {
+    magic |= static_cast<uint32_t>(header[i]) << (8 * i);
+    version |= static_cast<uint32_t>(header[4 + i]) << (8 * i);
+  }
+  if (!file || magic != TRACE_MAGIC)
+    throw std::runtime_error(filename.string() + " is not a trace.");
+  if (version != TRACE_VERSION)
+    throw std::runtime_error("Unsupported trace version.");
+}
+
+bool trace_reader_t::read_chunk() {
+  auto flags = file.get();
+  if (flags == std::char_traits<char>::eof())
+    return false;
+
+  stream = static_cast<uint32_t>(read_varint(file));
+  remaining = read_varint(file);
+  lost += read_varint(file);
+  payload.resize(read_varint(file));
+  file.read(reinterpret_cast<char *>(payload.data()),
+            static_cast<std::streamsize>(payload.size()));
+  if (!file)
+    throw std::runtime_error("Truncated trace.");
+
+  if (flags & TRACE_CHUNK_ZSTD) {
+#ifdef CHIP8_HAVE_ZSTD
+    auto size = ZSTD_getFrameContentSize(payload.data(), payload.size());
+    if (size == ZSTD_CONTENTSIZE_ERROR || size == ZSTD_CONTENTSIZE_UNKNOWN)
+      throw std::runtime_error("Corrupt trace chunk.");
+    std::vector<uint8_t> decompressed(size);
+    auto result = ZSTD_decompress(decompressed.data(), decompressed.size(),
+                                  payload.data(), payload.size());
+    if (ZSTD_isError(result))
+      throw std::runtime_error("Corrupt trace chunk.");
+    payload.swap(decompressed);
+#else
+    throw std::runtime_error("Trace needs zstd support.");
+#endif
+  }
+
+  position = payload.data();
+  previous = {};
+  expected_pc = 0;
+  return true;
+}
+
+bool trace_reader_t::next(trace_record_t &record, uint32_t &stream) {
+  while (remaining == 0) {
+    if (!read_chunk())
+      return false;
+  }
+
+  auto const *end = payload.data() + payload.size();
+  record.cycle = previous.cycle + get_varint(position, end);
+  auto pc = static_cast<int64_t>(expected_pc) +
+            unzigzag(get_varint(position, end));
+  record.pc = static_cast<uint16_t>(pc);
+  expected_pc = record.pc + 2u;
+  if (end - position < 3)
+    throw std::runtime_error("Corrupt trace chunk.");
+  record.opcode = static_cast<uint16_t>((position[0] << 8u) | position[1]);
+  auto reg = position[2];
+  position += 3;
+
+  record.reg = reg;
+  record.last = reg;
+  record.flag = false;
+  if (reg == TRACE_INDEX) {
+    record.index = static_cast<uint16_t>(get_varint(position, end));
+  } else if (reg != TRACE_NO_REGISTER) {
+    record.reg = reg & 0x0Fu;
+    record.flag = reg & TRACE_FLAG;
+    record.last = record.reg;
+    if (reg & TRACE_RANGE) {
+      if (position == end)
+        throw std::runtime_error("Corrupt trace chunk.");
+      record.last = *position++;
+    }
+    auto values = record.last - record.reg + 1 + (record.flag ? 1 : 0);
+    if ((reg & ~(TRACE_RANGE | TRACE_FLAG | 0x0Fu)) != 0 ||
+        record.last < record.reg || record.last >= REGISTER_COUNT ||
+        end - position < values)
+      throw std::runtime_error("Corrupt trace chunk.");
+    for (unsigned int i = record.reg; i <= record.last; ++i)
+      record.registers[i] = *position++;
+    if (record.flag)
+      record.registers[0xF] = *position++;
+  }
+
+  previous = record;
+  remaining -= 1;
+  stream = this->stream;
+  return true;
+}
@@ -0,0 +1,69 @@
+#include "vector_env.h"
+
+static chip8_t boot(char const *filename) {
+  auto chip8 = make_chip8();
+  load_rom(chip8.get(), filename);
+  return *chip8;
+}
+
+vector_env_t::vector_env_t(char const *filename, size_t count,
+                           unsigned int threads)
+    : arena(boot(filename), count), pool(threads) {
+  for (size_t env = 0; env < count; ++env)
+    machines.push_back(arena.acquire());
+}
+
+vector_env_t &vector_env_t::set_cycles_per_frame(unsigned int cycles) {
+  cycles_per_frame = cycles;
+  return *this;
+}
+
+vector_env_t &vector_env_t::set_reward(reward_fn_t reward) {
+  this->reward = std::move(reward);
+  return *this;
+}
+
+vector_env_t &vector_env_t::set_done(done_fn_t done) {
+  this->done = std::move(done);
+  return *this;
+}
+
+vector_env_t &vector_env_t::set_seed(uint32_t seed) {
+  arena.set_seed(seed);
+  return *this;
+}
+
+void vector_env_t::reset() {
+  for (auto *machine : machines)
+    arena.reset(machine);
+}
+
+void vector_env_t::reset(size_t env) { arena.reset(machines[env]); }
+
+void vector_env_t::step(uint16_t const *actions, unsigned int frames,
+                        uint8_t *observations, float *rewards,
+                        uint8_t *dones) {
+  pool.parallel_for(machines.size(), [&](size_t env) {
+    auto &machine = *machines[env];
+    for (unsigned int key = 0; key < KEY_COUNT; ++key)
+      machine.keypad[key] = static_cast<uint8_t>((actions[env] >> key) & 1u);
+
+    for (unsigned int i = 0; i < frames * cycles_per_frame; ++i)
+      run_cycle(&machine);
+
+    pack_video(machine.video, observations + env * PACKED_VIDEO_SIZE);
+    if (rewards)
+      rewards[env] = reward ? reward(machine) : 0.0f;
+
+    bool finished = done && done(machine);
+    if (dones)
+      dones[env] = finished;
+    if (finished)
+      arena.reset(&machine);
+  });
+}
+
+void vector_env_t::observe(uint8_t *observations) const {
+  for (size_t env = 0; env < machines.size(); ++env)
+    pack_video(machines[env]->video, observations + env * PACKED_VIDEO_SIZE);
+}
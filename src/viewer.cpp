@@ -1,4 +1,5 @@
 #include "viewer.h"
+#include "chip8.h"
 #include <stdexcept>
 
 void viewer_t::build() {
@@ -44,6 +45,9 @@ void viewer_t::update(void const *buffer, int pitch) {
   SDL_RenderCopy(renderer, texture, nullptr, nullptr);
   // Apply the texture to the renderer
   SDL_RenderPresent(renderer);
+
+  if (latency)
+    latency->presented(SDL_GetPerformanceCounter());
 }
 
 bool viewer_t::process_input(uint8_t *chip8_keypad) {
@@ -52,6 +56,10 @@ bool viewer_t::process_input(uint8_t *chip8_keypad) {
   SDL_Event event;
 
   while (SDL_PollEvent(&event)) {
+    uint8_t keypad[KEY_COUNT]{};
+    if (latency)
+      std::memcpy(keypad, chip8_keypad, KEY_COUNT);
+
     switch (event.type) {
     case SDL_QUIT: {
       quit = true;
@@ -197,6 +205,12 @@ bool viewer_t::process_input(uint8_t *chip8_keypad) {
       }
     } break;
     }
+
+    // Trace only events that reach the keypad, not auto-repeat.
+    if (latency && std::memcmp(keypad, chip8_keypad, KEY_COUNT) != 0) {
+      latency->key_written(SDL_GetPerformanceCounter(),
+                           SDL_GetTicks() - event.key.timestamp);
+    }
   }
 
   return quit;
@@ -231,6 +245,11 @@ viewer_t &viewer_t::set_window_scale(int scale) {
   window_scale = scale;
   return *this;
 }
+
+viewer_t &viewer_t::set_latency_tracer(latency_tracer_t *tracer) {
+  latency = tracer;
+  return *this;
+}
 void viewer_t::delay(uint32_t delay) {
   SDL_Delay(delay);
 }
@@ -0,0 +1,140 @@
+#include "vip_timing.h"
+#include "analyzer.h"
+#include <algorithm>
+
+// The interpreter's fetch and decode loop, paid by every instruction.
+const unsigned int VIP_FETCH_CYCLES = 40;
+
+unsigned int vip_cycles(chip8_t const *chip8, uint16_t opcode) {
+  auto x = (opcode & 0x0F00u) >> 8u;
+  unsigned int body = 0;
+
+  switch (decode(opcode)) {
+  case op_t::op_00E0:
+    // Clears 256 display bytes, 12 cycles each.
+    body = 3078;
+    break;
+  case op_t::op_00EE:
+    body = 10;
+    break;
+  case op_t::op_1nnn:
+  case op_t::op_Annn:
+    body = 12;
+    break;
+  case op_t::op_2nnn:
+    body = 26;
+    break;
+  case op_t::op_3xkk:
+  case op_t::op_4xkk:
+  case op_t::op_Ex9E:
+  case op_t::op_ExA1:
+    body = 14;
+    break;
+  case op_t::op_5xy0:
+  case op_t::op_9xy0:
+    body = 18;
+    break;
+  case op_t::op_6xkk:
+    body = 6;
+    break;
+  case op_t::op_7xkk:
+  case op_t::op_Fx07:
+  case op_t::op_Fx15:
+  case op_t::op_Fx18:
+    body = 10;
+    break;
+  case op_t::op_8xy0:
+  case op_t::op_8xy1:
+  case op_t::op_8xy2:
+  case op_t::op_8xy3:
+  case op_t::op_8xy4:
+  case op_t::op_8xy5:
+  case op_t::op_8xy6:
+  case op_t::op_8xy7:
+  case op_t::op_8xyE:
+    // Built and run as a one-instruction 1802 subroutine.
+    body = 44;
+    break;
+  case op_t::op_Bnnn:
+    body = 22;
+    break;
+  case op_t::op_Cxkk:
+    body = 36;
+    break;
+  case op_t::op_Dxyn: {
+    // Sprites that straddle a byte boundary are shifted into two bytes.
+    auto rows = opcode & 0x000Fu;
+    auto aligned = chip8->registers[x] % 8 == 0;
+    body = 26 + rows * (aligned ? 34 : 60);
+  } break;
+  case op_t::op_Fx0A:
+    // One pass of the key polling loop.
+    body = 19;
+    break;
+  case op_t::op_Fx1E:
+  case op_t::op_Fx29:
+    body = 16;
+    break;
+  case op_t::op_Fx33: {
+    // Repeated subtraction, one loop per unit of each digit.
+    auto value = chip8->registers[x];
+    body = 84 + 16 * (value / 100u + value / 10u % 10u + value % 10u);
+  } break;
+  case op_t::op_Fx55:
+  case op_t::op_Fx65:
+    body = 14 + 14 * (x + 1);
+    break;
+  case op_t::op_F002:
+  case op_t::op_Fx3A:
+  case op_t::op_null:
+    body = 10;
+    break;
+  }
+
+  return VIP_FETCH_CYCLES + body;
+}
+
+static bool is_skip(uint16_t opcode) {
+  switch (opcode >> 12u) {
+  case 0x3:
+  case 0x4:
+  case 0x5:
+  case 0x9:
+  case 0xE:
+    return true;
+  default:
+    return false;
+  }
+}
+
+unsigned int vip_clock_t::run_frame(chip8_t *chip8) {
+  tick_timers(chip8);
+  budget += VIP_FRAME_BUDGET;
+  total_frames += 1;
+
+  unsigned int executed = 0;
+  while (budget > 0) {
+    auto pc = chip8->pc & MEMORY_MASK;
+    auto opcode = static_cast<uint16_t>((chip8->memory[pc] << 8u) |
+                                        chip8->memory[pc + 1]);
+
+    // Dxyn synchronises with the display: unless the frame has just begun,
+    // the interpreter idles until the next interrupt and draws after it.
+    if ((opcode & 0xF000u) == 0xD000u && executed > 0) {
+      budget = 0;
+      break;
+    }
+
+    auto cost = vip_cycles(chip8, opcode);
+    step_instruction(chip8);
+    if (is_skip(opcode) && ((chip8->pc - pc) & MEMORY_MASK) == 4)
+      cost += VIP_SKIP_CYCLES;
+
+    budget -= cost;
+    total_cycles += cost;
+    executed += 1;
+  }
+
+  budget = std::max<int64_t>(budget, 1 - int64_t{VIP_FRAME_BUDGET});
+  return executed;
+}
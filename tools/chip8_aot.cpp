@@ -0,0 +1,32 @@
+#include "analyzer.h"
+#include "aot.h"
+#include "chip8.h"
+#include <fstream>
+#include <iostream>
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " <ROM> <Output.so>\n";
+    std::exit(EXIT_FAILURE);
+  }
+
+  char const *romFilename = argv[1];
+  path_t output = argv[2];
+
+  auto chip8 = make_chip8();
+  load_rom(chip8.get(), romFilename);
+
+  auto rom_end = static_cast<uint16_t>(PROGRAM_START_ADDRESS +
+                                       std::filesystem::file_size(romFilename));
+  auto analysis = analyze(chip8->memory, rom_end);
+
+  // Keep the generated source next to the module for inspection.
+  auto source = output;
+  source.replace_extension(".cpp");
+  std::ofstream(source) << translate(analysis, chip8->memory);
+
+  compile_module(source, output, CHIP8_INCLUDE_DIR);
+  std::cout << "Recompiled " << analysis.blocks.size() << " blocks into "
+            << output.string() << "\n";
+  return 0;
+}
@@ -0,0 +1,301 @@
+#include "chip8.h"
+#include "fusion.h"
+#include "state.h"
+#include "thread_pool.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <time.h>
+
+/*
+ * Runs a corpus of ROMs headlessly and compares them with golden output.
+ *
+ * The manifest lists one ROM per line, paths relative to the manifest:
+ *
+ *   <rom> <frames> <golden> [input script]
+ *
+ * An input script holds "<frame> <key mask>" lines; the mask (bit k = key k)
+ * is held from that frame on. A golden file holds one framebuffer hash per
+ * frame. The baseline file holds "<rom> <instructions per second>" lines.
+ * Throughput is measured in CPU time of the thread running the ROM, so ROMs
+ * running in parallel do not count each other's time.
+ * */
+
+const uint32_t CONFORMANCE_SEED = 0xC8C8C8C8u;
+
+struct test_case_t {
+  path_t rom;
+  unsigned int frames{};
+  path_t golden;
+  path_t inputs;
+};
+
+struct test_result_t {
+  std::vector<uint64_t> hashes;
+  double instructions_per_second{};
+  std::string error;
+};
+
+struct runner_options_t {
+  path_t manifest;
+  path_t baseline;
+  double threshold = 0.1;
+  unsigned int threads = std::thread::hardware_concurrency();
+  bool update{};
+  bool fusion{};
+  bool check_fusion{};
+};
+
+static uint64_t hash_frame(chip8_t const &chip8) {
+  uint8_t packed[PACKED_VIDEO_SIZE];
+  pack_video(chip8.video, packed);
+
+  uint64_t hash = 0xcbf29ce484222325u;
+  for (auto byte : packed) {
+    hash ^= byte;
+    hash *= 0x100000001b3u;
+  }
+  return hash;
+}
+
+static std::vector<test_case_t> read_manifest(path_t const &manifest) {
+  std::ifstream file(manifest);
+  if (!file.is_open())
+    throw std::runtime_error("Cannot open " + manifest.string() + ".");
+
+  auto directory = manifest.parent_path();
+  std::vector<test_case_t> cases;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#')
+      continue;
+
+    std::istringstream fields(line);
+    std::string rom, golden, inputs;
+    test_case_t test;
+    if (!(fields >> rom >> test.frames >> golden))
+      throw std::runtime_error("Malformed manifest line: " + line);
+    fields >> inputs;
+
+    test.rom = directory / rom;
+    test.golden = directory / golden;
+    if (!inputs.empty())
+      test.inputs = directory / inputs;
+    cases.push_back(test);
+  }
+  return cases;
+}
+
+static std::map<unsigned int, uint16_t> read_inputs(path_t const &inputs) {
+  std::map<unsigned int, uint16_t> script;
+  if (inputs.empty())
+    return script;
+
+  std::ifstream file(inputs);
+  if (!file.is_open())
+    throw std::runtime_error("Cannot open " + inputs.string() + ".");
+
+  unsigned int frame;
+  std::string mask;
+  while (file >> frame >> mask)
+    script[frame] = static_cast<uint16_t>(std::stoul(mask, nullptr, 0));
+  return script;
+}
+
+static double thread_seconds() {
+  timespec now{};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  return static_cast<double>(now.tv_sec) +
+         static_cast<double>(now.tv_nsec) * 1e-9;
+}
+
+static test_result_t run_test(test_case_t const &test,
+                              runner_options_t const &options) {
+  test_result_t result;
+  try {
+    auto script = read_inputs(test.inputs);
+    auto chip8 = make_chip8();
+    load_rom(chip8.get(), test.rom.c_str());
+    seed_random(chip8.get(), CONFORMANCE_SEED);
+
+    std::unique_ptr<fused_program_t> program;
+    if (options.fusion || options.check_fusion) {
+      program = std::make_unique<fused_program_t>();
+      program->predecode(chip8.get());
+    }
+    // The interpreter run the fused one is checked against.
+    chip8_ptr_t reference;
+    if (options.check_fusion)
+      reference = std::make_unique<chip8_t>(*chip8);
+
+    result.hashes.reserve(test.frames);
+    auto start = thread_seconds();
+    for (unsigned int frame = 0; frame < test.frames; ++frame) {
+      auto input = script.find(frame);
+      if (input != script.end()) {
+        for (unsigned int key = 0; key < KEY_COUNT; ++key) {
+          chip8->keypad[key] =
+              static_cast<uint8_t>((input->second >> key) & 1u);
+          if (reference)
+            reference->keypad[key] = chip8->keypad[key];
+        }
+      }
+
+      if (program) {
+        program->run(chip8.get(), CYCLES_PER_FRAME);
+      } else {
+        for (unsigned int i = 0; i < CYCLES_PER_FRAME; ++i)
+          run_cycle(chip8.get());
+      }
+      result.hashes.push_back(hash_frame(*chip8));
+
+      if (reference) {
+        for (unsigned int i = 0; i < CYCLES_PER_FRAME; ++i)
+          run_cycle(reference.get());
+        if (hash_state(chip8.get()) != hash_state(reference.get()) ||
+            chip8->opcode != reference->opcode) {
+          throw std::runtime_error("fused state differs from run_cycle() "
+                                   "after frame " +
+                                   std::to_string(frame));
+        }
+      }
+    }
+    auto elapsed = thread_seconds() - start;
+
+    result.instructions_per_second =
+        test.frames * CYCLES_PER_FRAME / std::max(elapsed, 1e-9);
+  } catch (std::exception const &error) {
+    result.error = error.what();
+  }
+  return result;
+}
+
+static std::vector<uint64_t> read_golden(path_t const &golden) {
+  std::vector<uint64_t> hashes;
+  std::ifstream file(golden);
+  std::string hash;
+  while (file >> hash)
+    hashes.push_back(std::stoull(hash, nullptr, 16));
+  return hashes;
+}
+
+static void write_golden(path_t const &golden,
+                         std::vector<uint64_t> const &hashes) {
+  std::filesystem::create_directories(golden.parent_path());
+  std::ofstream file(golden);
+  for (auto hash : hashes)
+    file << std::hex << hash << "\n";
+}
+
+static std::map<std::string, double> read_baseline(path_t const &baseline) {
+  std::map<std::string, double> rates;
+  std::ifstream file(baseline);
+  std::string rom;
+  double rate;
+  while (file >> rom >> rate)
+    rates[rom] = rate;
+  return rates;
+}
+
+static void usage(char const *program) {
+  std::cerr << "Usage: " << program << " <Manifest> [options]\n"
+            << "Options:\n"
+            << "  --baseline FILE   instructions/second to compare against\n"
+            << "  --threshold F     allowed throughput drop, 0.1 = 10%\n"
+            << "  --threads N       ROMs run in parallel\n"
+            << "  --update          rewrite golden files and the baseline\n"
+            << "  --fusion          run through the fused interpreter\n"
+            << "  --check-fusion    run fused and compare the whole state\n"
+            << "                    with run_cycle() after every frame\n";
+  std::exit(EXIT_FAILURE);
+}
+
+static runner_options_t parse_options(int argc, char *argv[]) {
+  if (argc < 2)
+    usage(argv[0]);
+
+  runner_options_t options;
+  options.manifest = argv[1];
+  for (int i = 2; i < argc; ++i) {
+    auto has_value = i + 1 < argc;
+    if (std::strcmp(argv[i], "--baseline") == 0 && has_value)
+      options.baseline = argv[++i];
+    else if (std::strcmp(argv[i], "--threshold") == 0 && has_value)
+      options.threshold = std::stod(argv[++i]);
+    else if (std::strcmp(argv[i], "--threads") == 0 && has_value)
+      options.threads = static_cast<unsigned int>(std::stoul(argv[++i]));
+    else if (std::strcmp(argv[i], "--update") == 0)
+      options.update = true;
+    else if (std::strcmp(argv[i], "--fusion") == 0)
+      options.fusion = true;
+    else if (std::strcmp(argv[i], "--check-fusion") == 0)
+      options.check_fusion = true;
+    else
+      usage(argv[0]);
+  }
+  return options;
+}
+
+int main(int argc, char *argv[]) {
+  auto options = parse_options(argc, argv);
+  auto cases = read_manifest(options.manifest);
+
+  std::vector<test_result_t> results(cases.size());
+  thread_pool_t pool(options.threads);
+  pool.parallel_for(cases.size(), [&](size_t i) {
+    results[i] = run_test(cases[i], options);
+  });
+
+  auto baseline = read_baseline(options.baseline);
+  std::ofstream updated_baseline;
+  if (options.update && !options.baseline.empty())
+    updated_baseline.open(options.baseline);
+
+  unsigned int failures = 0;
+  for (size_t i = 0; i < cases.size(); ++i) {
+    auto const &test = cases[i];
+    auto const &result = results[i];
+    auto name = test.rom.filename().string();
+    std::string status = "ok";
+
+    if (!result.error.empty()) {
+      status = "error: " + result.error;
+    } else if (options.update) {
+      write_golden(test.golden, result.hashes);
+      if (updated_baseline.is_open())
+        updated_baseline << name << " " << result.instructions_per_second
+                         << "\n";
+      status = "updated";
+    } else {
+      auto golden = read_golden(test.golden);
+      if (golden.size() != result.hashes.size()) {
+        status = "golden has " + std::to_string(golden.size()) +
+                 " frames, ran " + std::to_string(result.hashes.size());
+      }
+      for (size_t frame = 0; status == "ok" && frame < golden.size();
+           ++frame) {
+        if (golden[frame] != result.hashes[frame])
+          status = "mismatch at frame " + std::to_string(frame);
+      }
+
+      auto expected = baseline.find(name);
+      if (status == "ok" && expected != baseline.end() &&
+          result.instructions_per_second <
+              expected->second * (1.0 - options.threshold)) {
+        status = "throughput regression, baseline " +
+                 std::to_string(expected->second) + " ips";
+      }
+    }
+
+    if (status != "ok" && status != "updated")
+      failures += 1;
+    std::cout << name << ": " << result.instructions_per_second << " ips, "
+              << status << "\n";
+  }
+
+  std::cout << cases.size() - failures << "/" << cases.size() << " passed\n";
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
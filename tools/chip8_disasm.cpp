@@ -0,0 +1,28 @@
+#include "analyzer.h"
+#include "chip8.h"
+#include <cstring>
+#include <iostream>
+
+int main(int argc, char *argv[]) {
+  if (argc < 2 || argc > 3 || (argc == 3 && std::strcmp(argv[2], "--json"))) {
+    std::cerr << "Usage: " << argv[0] << " <ROM> [--json]\n";
+    std::exit(EXIT_FAILURE);
+  }
+
+  char const *romFilename = argv[1];
+  bool json = argc == 3;
+
+  auto chip8 = make_chip8();
+  load_rom(chip8.get(), romFilename);
+
+  auto rom_end = static_cast<uint16_t>(PROGRAM_START_ADDRESS +
+                                       std::filesystem::file_size(romFilename));
+  auto analysis = analyze(chip8->memory, rom_end);
+
+  if (json)
+    write_json(std::cout, analysis);
+  else
+    write_text(std::cout, analysis, chip8->memory);
+
+  return 0;
+}
@@ -0,0 +1,115 @@
+#include "analyzer.h"
+#include "chip8.h"
+#include "explorer.h"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+/*
+ * Explores the states a ROM can reach from boot and reports crashes,
+ * soft-locks and which of the instructions found by the analyzer ran.
+ * */
+
+const uint32_t EXPLORER_SEED = 0xC8C8C8C8u;
+const size_t MAX_LISTED_FINDINGS = 10;
+
+struct explore_options_t {
+  char const *rom{};
+  unsigned int depth = 64;
+  unsigned int hold = 1;
+  size_t max_states = 20000;
+  unsigned int threads = std::thread::hardware_concurrency();
+};
+
+static std::string hex(unsigned int value) {
+  char buffer[16];
+  std::snprintf(buffer, sizeof(buffer), "%03X", value);
+  return buffer;
+}
+
+static void usage(char const *program) {
+  std::cerr << "Usage: " << program << " <ROM> [options]\n"
+            << "Options:\n"
+            << "  --depth N        steps from boot\n"
+            << "  --hold N         frames each input is held per step\n"
+            << "  --max-states N   stop after N distinct states\n"
+            << "  --threads N      worker threads\n";
+  std::exit(EXIT_FAILURE);
+}
+
+static explore_options_t parse_options(int argc, char *argv[]) {
+  if (argc < 2)
+    usage(argv[0]);
+
+  explore_options_t options;
+  options.rom = argv[1];
+  for (int i = 2; i < argc; ++i) {
+    auto has_value = i + 1 < argc;
+    if (std::strcmp(argv[i], "--depth") == 0 && has_value)
+      options.depth = static_cast<unsigned int>(std::stoul(argv[++i]));
+    else if (std::strcmp(argv[i], "--hold") == 0 && has_value)
+      options.hold = static_cast<unsigned int>(std::stoul(argv[++i]));
+    else if (std::strcmp(argv[i], "--max-states") == 0 && has_value)
+      options.max_states = std::stoull(argv[++i]);
+    else if (std::strcmp(argv[i], "--threads") == 0 && has_value)
+      options.threads = static_cast<unsigned int>(std::stoul(argv[++i]));
+    else
+      usage(argv[0]);
+  }
+  return options;
+}
+
+static void write_findings(char const *title,
+                           std::vector<explorer_finding_t> const &findings) {
+  std::cout << title << ": " << findings.size() << "\n";
+  for (size_t i = 0; i < std::min(findings.size(), MAX_LISTED_FINDINGS); ++i) {
+    auto const &finding = findings[i];
+    std::cout << "  0x" << hex(finding.pc) << " " << finding.what
+              << "\n    inputs:";
+    for (auto mask : finding.inputs)
+      std::cout << " " << std::hex << mask << std::dec;
+    std::cout << "\n";
+  }
+}
+
+int main(int argc, char *argv[]) {
+  auto options = parse_options(argc, argv);
+
+  auto chip8 = make_chip8();
+  load_rom(chip8.get(), options.rom);
+  seed_random(chip8.get(), EXPLORER_SEED);
+
+  explorer_t explorer(*chip8, options.threads);
+  explorer.set_max_depth(options.depth)
+      .set_frames_per_step(options.hold)
+      .set_max_states(options.max_states);
+  auto report = explorer.run();
+
+  auto rom_end = static_cast<uint16_t>(
+      PROGRAM_START_ADDRESS + std::filesystem::file_size(options.rom));
+  auto analysis = analyze(chip8->memory, rom_end);
+
+  size_t reached = (analysis.instructions & report.pcs).count();
+  size_t total = analysis.instructions.count();
+  std::cout << report.states << " states, depth " << report.depth
+            << (report.exhausted ? " (exhausted)" : " (limit reached)")
+            << "\n"
+            << "coverage: " << reached << "/" << total
+            << " instructions found by the analyzer, "
+            << (report.pcs & ~analysis.instructions).count()
+            << " other addresses executed\n";
+
+  std::cout << "not reached:";
+  size_t listed = 0;
+  for (unsigned int address = 0; address < MEMORY_SIZE; ++address) {
+    if (analysis.instructions[address] && !report.pcs[address] &&
+        listed++ < 32)
+      std::cout << " 0x" << hex(address);
+  }
+  std::cout << (listed > 32 ? " ..." : "") << "\n";
+
+  write_findings("crashes", report.crashes);
+  write_findings("soft-locks", report.soft_locks);
+  return report.crashes.empty() && report.soft_locks.empty() ? EXIT_SUCCESS
+                                                             : EXIT_FAILURE;
+}
@@ -0,0 +1,253 @@
+#include "recorder.h"
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+/*
+ * Converts a recording made with --record into an animated GIF. Runs of
+ * identical frames become one GIF frame with a longer delay.
+ * */
+
+const unsigned int GIF_MIN_CODE_SIZE = 2;
+const unsigned int GIF_MAX_CODE = 4095;
+
+struct export_options_t {
+  char const *recording{};
+  char const *output{};
+  unsigned int scale = 4;
+  double fps = 60.0;
+  uint64_t from{};
+  uint64_t to = UINT64_MAX;
+};
+
+/**
+ * @brief Packs variable-width LZW codes least significant bit first into
+ * GIF data sub-blocks of at most 255 bytes.
+ */
+class gif_code_writer_t {
+public:
+  explicit gif_code_writer_t(std::ostream &out) : out(out) {}
+
+  void write(unsigned int code, unsigned int size) {
+    bits |= static_cast<uint64_t>(code) << count;
+    count += size;
+    while (count >= 8) {
+      put(static_cast<uint8_t>(bits));
+      bits >>= 8u;
+      count -= 8;
+    }
+  }
+
+  void finish() {
+    if (count > 0)
+      put(static_cast<uint8_t>(bits));
+    flush();
+    out.put(0);
+  }
+
+private:
+  void put(uint8_t byte) {
+    block[length++] = byte;
+    if (length == block.size())
+      flush();
+  }
+
+  void flush() {
+    if (length == 0)
+      return;
+    out.put(static_cast<char>(length));
+    out.write(reinterpret_cast<char const *>(block.data()),
+              static_cast<std::streamsize>(length));
+    length = 0;
+  }
+
+  std::ostream &out;
+  uint64_t bits{};
+  unsigned int count{};
+  std::array<uint8_t, 255> block{};
+  size_t length{};
+};
+
+static void put_u16(std::ostream &out, unsigned int value) {
+  out.put(static_cast<char>(value & 0xFFu));
+  out.put(static_cast<char>((value >> 8u) & 0xFFu));
+}
+
+static void write_lzw(std::ostream &out, std::vector<uint8_t> const &pixels) {
+  const unsigned int clear = 1u << GIF_MIN_CODE_SIZE;
+  const unsigned int end_of_information = clear + 1;
+
+  // children[code][pixel] is the code extending code by pixel, 0 if none.
+  std::vector<std::array<uint16_t, clear>> children(GIF_MAX_CODE + 1);
+  unsigned int last_code = end_of_information;
+  unsigned int code_size = GIF_MIN_CODE_SIZE + 1;
+
+  out.put(static_cast<char>(GIF_MIN_CODE_SIZE));
+  gif_code_writer_t writer(out);
+  writer.write(clear, code_size);
+
+  unsigned int prefix = pixels[0];
+  for (size_t i = 1; i < pixels.size(); ++i) {
+    auto pixel = pixels[i];
+    if (children[prefix][pixel] != 0) {
+      prefix = children[prefix][pixel];
+      continue;
+    }
+
+    writer.write(prefix, code_size);
+    children[prefix][pixel] = static_cast<uint16_t>(++last_code);
+    if (last_code >= (1u << code_size))
+      code_size += 1;
+    if (last_code == GIF_MAX_CODE) {
+      writer.write(clear, code_size);
+      std::fill(children.begin(), children.end(),
+                std::array<uint16_t, clear>{});
+      last_code = end_of_information;
+      code_size = GIF_MIN_CODE_SIZE + 1;
+    }
+    prefix = pixel;
+  }
+
+  writer.write(prefix, code_size);
+  writer.write(end_of_information, code_size);
+  writer.finish();
+}
+
+static void write_frame(std::ostream &out, uint8_t const *packed,
+                        unsigned int scale, unsigned int delay) {
+  auto width = VIDEO_WIDTH * scale;
+  auto height = VIDEO_HEIGHT * scale;
+
+  // Graphic control extension: no transparency, delay in 1/100 s.
+  out.put('\x21').put('\xF9').put(4).put(0);
+  put_u16(out, delay);
+  out.put(0).put(0);
+
+  out.put('\x2C');
+  put_u16(out, 0);
+  put_u16(out, 0);
+  put_u16(out, width);
+  put_u16(out, height);
+  out.put(0);
+
+  std::vector<uint8_t> pixels(width * height);
+  for (unsigned int y = 0; y < height; ++y) {
+    for (unsigned int x = 0; x < width; ++x) {
+      auto bit = (y / scale) * VIDEO_WIDTH + x / scale;
+      pixels[y * width + x] =
+          static_cast<uint8_t>((packed[bit / 8] >> (7u - bit % 8)) & 1u);
+    }
+  }
+  write_lzw(out, pixels);
+}
+
+static void usage(char const *program) {
+  std::cerr << "Usage: " << program << " <Recording> <Output.gif> [options]\n"
+            << "Options:\n"
+            << "  --scale N   pixels per CHIP-8 pixel\n"
+            << "  --fps F     playback rate of the recording\n"
+            << "  --from N    first frame\n"
+            << "  --to N      frame after the last one\n";
+  std::exit(EXIT_FAILURE);
+}
+
+static export_options_t parse_options(int argc, char *argv[]) {
+  if (argc < 3)
+    usage(argv[0]);
+
+  export_options_t options;
+  options.recording = argv[1];
+  options.output = argv[2];
+  for (int i = 3; i < argc; ++i) {
+    auto has_value = i + 1 < argc;
+    if (std::strcmp(argv[i], "--scale") == 0 && has_value)
+      options.scale = static_cast<unsigned int>(std::stoul(argv[++i]));
+    else if (std::strcmp(argv[i], "--fps") == 0 && has_value)
+      options.fps = std::stod(argv[++i]);
+    else if (std::strcmp(argv[i], "--from") == 0 && has_value)
+      options.from = std::stoull(argv[++i]);
+    else if (std::strcmp(argv[i], "--to") == 0 && has_value)
+      options.to = std::stoull(argv[++i]);
+    else
+      usage(argv[0]);
+  }
+
+  if (options.scale == 0 || options.fps <= 0)
+    usage(argv[0]);
+  return options;
+}
+
+static int export_gif(export_options_t const &options) {
+  recording_reader_t reader(options.recording);
+  auto last = std::min(options.to, reader.frame_count());
+  if (options.from >= last) {
+    std::cerr << "No frames in range, the recording has "
+              << reader.frame_count() << ".\n";
+    return EXIT_FAILURE;
+  }
+
+  std::ofstream out(options.output, std::ios::binary);
+  if (!out.is_open()) {
+    std::cerr << "Cannot open " << options.output << ".\n";
+    return EXIT_FAILURE;
+  }
+
+  out.write("GIF89a", 6);
+  put_u16(out, VIDEO_WIDTH * options.scale);
+  put_u16(out, VIDEO_HEIGHT * options.scale);
+  // Global color table of two entries: black and white.
+  out.put('\x80').put(0).put(0);
+  out.write("\x00\x00\x00\xFF\xFF\xFF", 6);
+  // Loop forever.
+  out.write("\x21\xFF\x0BNETSCAPE2.0\x03\x01\x00\x00\x00", 19);
+
+  // Delays are rounded against the running total so that long exports keep
+  // the recording's pace.
+  auto centiseconds = [&](uint64_t frame) {
+    return static_cast<unsigned int>(
+        std::lround(static_cast<double>(frame - options.from) * 100.0 /
+                    options.fps));
+  };
+
+  uint8_t shown[PACKED_VIDEO_SIZE];
+  uint8_t frame[PACKED_VIDEO_SIZE];
+  reader.seek(options.from, shown);
+  uint64_t shown_since = options.from;
+  unsigned int gif_frames = 0;
+
+  for (auto index = options.from + 1; index <= last; ++index) {
+    auto more = index < last && reader.next(frame);
+    if (more && std::memcmp(frame, shown, PACKED_VIDEO_SIZE) == 0)
+      continue;
+
+    // GIF delays are whole centiseconds; shorter frames are dropped.
+    auto delay = centiseconds(index) - centiseconds(shown_since);
+    if (delay == 0 && more)
+      continue;
+    write_frame(out, shown, options.scale, std::min(delay, 0xFFFFu));
+    gif_frames += 1;
+    if (!more)
+      break;
+    std::memcpy(shown, frame, PACKED_VIDEO_SIZE);
+    shown_since = index;
+  }
+
+  out.put('\x3B');
+  std::cout << last - options.from << " frames written as " << gif_frames
+            << " GIF frames\n";
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  auto options = parse_options(argc, argv);
+  try {
+    return export_gif(options);
+  } catch (std::exception const &error) {
+    std::cerr << error.what() << "\n";
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,107 @@
+#include "chip8.h"
+#include "session_host.h"
+#include "shared_frame.h"
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+/*
+ * Hosts many headless sessions in one process. Every session can publish its
+ * frames and take key presses through its own shared-memory segment, named
+ * <prefix><session>, so viewers and bots attach exactly as they do to a
+ * single chip8_interpreter started with --shm.
+ * */
+
+struct host_options_t {
+  std::vector<char const *> roms;
+  unsigned int copies = 1;
+  unsigned int threads = 2;
+  uint64_t frames{};
+  char const *shared_prefix{};
+};
+
+static std::atomic<bool> interrupted{};
+
+static void usage(char const *program) {
+  std::cerr << "Usage: " << program << " <ROM>... [options]\n"
+            << "Options:\n"
+            << "  --copies N    sessions started per ROM\n"
+            << "  --threads N   worker threads\n"
+            << "  --frames N    end each session after N frames\n"
+            << "  --shm PREFIX  publish session i to PREFIX<i>\n";
+  std::exit(EXIT_FAILURE);
+}
+
+static host_options_t parse_options(int argc, char *argv[]) {
+  host_options_t options;
+  for (int i = 1; i < argc; ++i) {
+    auto has_value = i + 1 < argc;
+    if (std::strcmp(argv[i], "--copies") == 0 && has_value)
+      options.copies = static_cast<unsigned int>(std::stoul(argv[++i]));
+    else if (std::strcmp(argv[i], "--threads") == 0 && has_value)
+      options.threads = static_cast<unsigned int>(std::stoul(argv[++i]));
+    else if (std::strcmp(argv[i], "--frames") == 0 && has_value)
+      options.frames = std::stoull(argv[++i]);
+    else if (std::strcmp(argv[i], "--shm") == 0 && has_value)
+      options.shared_prefix = argv[++i];
+    else if (argv[i][0] == '-')
+      usage(argv[0]);
+    else
+      options.roms.push_back(argv[i]);
+  }
+
+  if (options.roms.empty())
+    usage(argv[0]);
+  return options;
+}
+
+int main(int argc, char *argv[]) {
+  auto options = parse_options(argc, argv);
+
+  session_host_t host(options.threads);
+  std::vector<std::unique_ptr<shared_frame_writer_t>> shared;
+  std::vector<uint64_t> frames;
+
+  for (auto rom : options.roms) {
+    for (unsigned int copy = 0; copy < options.copies; ++copy) {
+      auto chip8 = make_chip8();
+      load_rom(chip8.get(), rom);
+      auto session = host.add(std::move(chip8));
+
+      if (options.shared_prefix)
+        shared.push_back(std::make_unique<shared_frame_writer_t>(
+            options.shared_prefix + std::to_string(session)));
+      frames.push_back(0);
+    }
+  }
+
+  // Each callback only touches its own session's slots, and a session runs
+  // on one worker at a time.
+  host.set_on_frame([&](size_t session, chip8_t *chip8) {
+    if (!shared.empty()) {
+      shared[session]->publish(chip8);
+      shared[session]->apply_input(chip8);
+    }
+    frames[session] += 1;
+    return interrupted || (options.frames != 0 &&
+                           frames[session] >= options.frames);
+  });
+
+  std::signal(SIGINT, [](int) { interrupted = true; });
+  host.run();
+
+  for (size_t session = 0; session < host.size(); ++session) {
+    auto stats = host.stats(session);
+    auto lateness =
+        std::chrono::duration<double, std::milli>(stats.max_lateness);
+    std::cout << "session " << session << ": " << stats.frames << " frames, "
+              << stats.late_frames << " late, max lateness "
+              << lateness.count() << " ms";
+    if (!stats.error.empty())
+      std::cout << ", error: " << stats.error;
+    std::cout << "\n";
+  }
+  return 0;
+}
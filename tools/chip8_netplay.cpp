@@ -0,0 +1,166 @@
+#include "chip8.h"
+#include "netplay.h"
+#include "state.h"
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+/*
+ * Plays a ROM with two netplay peers in one process, talking over loopback
+ * through links with simulated latency and loss, and scripted inputs. The
+ * state hashes of every confirmed frame are compared between the peers and
+ * with an offline run that knows all inputs up front.
+ * */
+
+struct netplay_options_t {
+  char const *rom{};
+  unsigned int frames = 600;
+  unsigned int latency_ms = 30;
+  double loss = 0.05;
+  unsigned int frame_us = 1000000 / 60;
+  uint16_t port = 47800;
+  uint32_t seed = 1;
+};
+
+struct peer_t {
+  unsigned int player;
+  chip8_ptr_t chip8;
+  std::unique_ptr<udp_link_t> link;
+  std::unique_ptr<netplay_t> netplay;
+  std::vector<uint64_t> hashes;
+};
+
+static void usage(char const *program) {
+  std::cerr << "Usage: " << program << " <ROM> [options]\n"
+            << "Options:\n"
+            << "  --frames N      confirmed frames to compare\n"
+            << "  --latency MS    simulated one-way latency\n"
+            << "  --loss P        simulated packet loss, 0.05 = 5%\n"
+            << "  --frame-us N    frame period, 16666 plays in real time\n"
+            << "  --port N        first of the two loopback ports\n"
+            << "  --seed N        seed for inputs and packet loss\n";
+  std::exit(EXIT_FAILURE);
+}
+
+static netplay_options_t parse_options(int argc, char *argv[]) {
+  if (argc < 2)
+    usage(argv[0]);
+
+  netplay_options_t options;
+  options.rom = argv[1];
+  for (int i = 2; i < argc; ++i) {
+    auto has_value = i + 1 < argc;
+    if (std::strcmp(argv[i], "--frames") == 0 && has_value)
+      options.frames = static_cast<unsigned int>(std::stoul(argv[++i]));
+    else if (std::strcmp(argv[i], "--latency") == 0 && has_value)
+      options.latency_ms = static_cast<unsigned int>(std::stoul(argv[++i]));
+    else if (std::strcmp(argv[i], "--loss") == 0 && has_value)
+      options.loss = std::stod(argv[++i]);
+    else if (std::strcmp(argv[i], "--frame-us") == 0 && has_value)
+      options.frame_us = static_cast<unsigned int>(std::stoul(argv[++i]));
+    else if (std::strcmp(argv[i], "--port") == 0 && has_value)
+      options.port = static_cast<uint16_t>(std::stoul(argv[++i]));
+    else if (std::strcmp(argv[i], "--seed") == 0 && has_value)
+      options.seed = static_cast<uint32_t>(std::stoul(argv[++i]));
+    else
+      usage(argv[0]);
+  }
+  return options;
+}
+
+/**
+ * @brief The scripted keys of player at frame: no key or one key, held for
+ * eight frames at a time.
+ */
+static uint16_t script_keys(uint32_t seed, unsigned int player,
+                            uint64_t frame) {
+  uint64_t key[] = {seed, player, frame / 8};
+  auto random = hash_bytes(key, sizeof(key));
+  return random % 3 == 0 ? 0 : static_cast<uint16_t>(1u << (random % 16));
+}
+
+static chip8_ptr_t boot(char const *rom) {
+  auto chip8 = make_chip8();
+  load_rom(chip8.get(), rom);
+  seed_random(chip8.get(), NETPLAY_SEED);
+  return chip8;
+}
+
+int main(int argc, char *argv[]) {
+  auto options = parse_options(argc, argv);
+
+  peer_t peers[2];
+  for (unsigned int player = 0; player < 2; ++player) {
+    auto &peer = peers[player];
+    peer.player = player;
+    peer.chip8 = boot(options.rom);
+    peer.link = std::make_unique<udp_link_t>(options.port + player,
+                                             "127.0.0.1",
+                                             options.port + 1 - player);
+    peer.link->set_latency(std::chrono::milliseconds(options.latency_ms))
+        .set_loss(options.loss)
+        .set_seed(options.seed * 2 + player);
+    peer.netplay = std::make_unique<netplay_t>(*peer.link);
+    peer.netplay->set_on_confirmed(
+        [&peer, &options](uint64_t frame, chip8_t const *chip8) {
+          if (frame < options.frames)
+            peer.hashes.push_back(hash_state(chip8).value());
+        });
+  }
+
+  // Both peers keep playing until both confirmed enough frames, so the
+  // inputs the other one still needs keep being sent.
+  std::atomic<unsigned int> done{};
+  auto play = [&](peer_t &peer) {
+    bool finished = false;
+    auto deadline = std::chrono::steady_clock::now();
+    while (done < 2) {
+      auto frame = peer.netplay->frame();
+      peer.netplay->advance(peer.chip8.get(),
+                            script_keys(options.seed, peer.player, frame));
+      if (!finished && peer.netplay->confirmed_frames() >= options.frames) {
+        finished = true;
+        done += 1;
+      }
+      deadline += std::chrono::microseconds(options.frame_us);
+      std::this_thread::sleep_until(deadline);
+    }
+  };
+  std::thread second(play, std::ref(peers[1]));
+  play(peers[0]);
+  second.join();
+
+  auto reference = boot(options.rom);
+  unsigned int mismatches = 0;
+  for (uint64_t frame = 0; frame < options.frames; ++frame) {
+    auto keys = static_cast<uint16_t>(script_keys(options.seed, 0, frame) |
+                                      script_keys(options.seed, 1, frame));
+    for (unsigned int key = 0; key < KEY_COUNT; ++key)
+      reference->keypad[key] = static_cast<uint8_t>((keys >> key) & 1u);
+    for (unsigned int cycle = 0; cycle < CYCLES_PER_FRAME; ++cycle)
+      run_cycle(reference.get());
+
+    auto expected = hash_state(reference.get()).value();
+    if (peers[0].hashes[frame] != expected ||
+        peers[1].hashes[frame] != expected) {
+      if (mismatches++ == 0)
+        std::cout << "first mismatch at frame " << frame << "\n";
+    }
+  }
+
+  for (auto const &peer : peers) {
+    auto const &stats = peer.netplay->stats();
+    std::cout << "peer " << peer.player << ": " << stats.frames
+              << " frames, " << stats.stalls << " stalls, "
+              << stats.rollbacks << " rollbacks resimulating "
+              << stats.resimulated_frames << " frames (max "
+              << stats.max_rollback << ", " << stats.max_rollback_ms
+              << " ms), " << stats.packets_sent << " packets sent, "
+              << stats.packets_received << " received, " << stats.desyncs
+              << " desyncs\n";
+  }
+  std::cout << options.frames - mismatches << "/" << options.frames
+            << " confirmed frames match the offline run\n";
+  return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
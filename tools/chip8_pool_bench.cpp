@@ -0,0 +1,75 @@
+#include "machine_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+/*
+ * Times three ways of getting a freshly booted machine for a ROM:
+ *
+ *   - make_chip8() and copying the ROM image in, as before machine_pool_t;
+ *   - acquire() and release() on a pool;
+ *   - reset() of a machine already handed out.
+ *
+ * Every figure is the mean over the given number of iterations.
+ * */
+
+using bench_clock_t = std::chrono::steady_clock;
+
+static double nanoseconds_per(bench_clock_t::time_point start,
+                              unsigned int iterations) {
+  std::chrono::duration<double, std::nano> elapsed =
+      bench_clock_t::now() - start;
+  return elapsed.count() / iterations;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 2 && !(argc == 4 && std::strcmp(argv[2], "--iterations") == 0)) {
+    std::cerr << "Usage: " << argv[0] << " <ROM> [--iterations N]\n";
+    std::exit(EXIT_FAILURE);
+  }
+  auto iterations = argc == 4
+                        ? static_cast<unsigned int>(std::stoul(argv[3]))
+                        : 1000000u;
+  iterations = std::max(iterations, 1u);
+
+  auto image = make_chip8();
+  load_rom(image.get(), argv[1]);
+
+  // Reading a byte of each machine keeps the work from being optimized out.
+  unsigned int sink = 0;
+
+  auto start = bench_clock_t::now();
+  for (unsigned int i = 0; i < iterations; ++i) {
+    auto chip8 = make_chip8();
+    std::memcpy(chip8->memory + PROGRAM_START_ADDRESS,
+                image->memory + PROGRAM_START_ADDRESS,
+                MEMORY_SIZE - PROGRAM_START_ADDRESS);
+    sink += chip8->memory[PROGRAM_START_ADDRESS + i % 64];
+  }
+  auto boot = nanoseconds_per(start, iterations);
+
+  machine_pool_t pool(*image, 64);
+  start = bench_clock_t::now();
+  for (unsigned int i = 0; i < iterations; ++i) {
+    auto *chip8 = pool.acquire();
+    sink += chip8->memory[PROGRAM_START_ADDRESS + i % 64];
+    pool.release(chip8);
+  }
+  auto acquire = nanoseconds_per(start, iterations);
+
+  auto *chip8 = pool.acquire();
+  start = bench_clock_t::now();
+  for (unsigned int i = 0; i < iterations; ++i) {
+    pool.reset(chip8);
+    sink += chip8->memory[PROGRAM_START_ADDRESS + i % 64];
+  }
+  auto reset = nanoseconds_per(start, iterations);
+
+  std::cout << "make_chip8 + ROM copy: " << boot << " ns\n"
+            << "acquire + release:     " << acquire << " ns\n"
+            << "reset:                 " << reset << " ns\n"
+            << "huge pages: " << (pool.huge_pages() ? "yes" : "no") << "\n"
+            << "checksum: " << sink << "\n";
+  return 0;
+}
@@ -0,0 +1,56 @@
+#include "analyzer.h"
+#include "trace.h"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+/*
+ * Decodes a binary trace written by --trace into one line per instruction:
+ *
+ *   <stream> <cycle> <pc> <opcode> <mnemonic> [<register>=<value> ...]
+ * */
+
+static std::string hex(unsigned int value, int digits) {
+  char buffer[16];
+  std::snprintf(buffer, sizeof(buffer), "%0*X", digits, value);
+  return buffer;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2 || argc > 4 ||
+      (argc > 2 && (std::strcmp(argv[2], "--stream") != 0 || argc != 4))) {
+    std::cerr << "Usage: " << argv[0] << " <Trace> [--stream N]\n";
+    std::exit(EXIT_FAILURE);
+  }
+
+  bool filter = argc == 4;
+  auto only = filter ? static_cast<uint32_t>(std::stoul(argv[3])) : 0;
+
+  trace_reader_t reader(argv[1]);
+  trace_record_t record;
+  uint32_t stream;
+  while (reader.next(record, stream)) {
+    if (filter && stream != only)
+      continue;
+
+    std::cout << stream << " " << record.cycle << " " << hex(record.pc, 3)
+              << " " << hex(record.opcode, 4) << " "
+              << disassemble(record.opcode);
+    if (record.reg == TRACE_INDEX) {
+      std::cout << " I=" << hex(record.index, 3);
+    } else if (record.reg != TRACE_NO_REGISTER) {
+      for (unsigned int reg = record.reg; reg <= record.last; ++reg) {
+        std::cout << " V" << hex(reg, 1) << "="
+                  << hex(record.registers[reg], 2);
+      }
+      if (record.flag)
+        std::cout << " VF=" << hex(record.registers[0xF], 2);
+    }
+    std::cout << "\n";
+  }
+
+  if (reader.lost_records() > 0)
+    std::cerr << reader.lost_records() << " records were dropped while "
+              << "tracing\n";
+  return 0;
+}